@@ -0,0 +1,58 @@
+#!/usr/bin/env python3
+# Records the local_score queries of one GES run and replays them against
+# the score backends: throughput and latency percentiles per backend, for
+# the full query stream and for the cache misses alone.
+import argparse
+import os
+import tempfile
+import time
+
+import numpy as np
+from gescpp import replay_trace, run_ges
+
+
+def main():
+    parser = argparse.ArgumentParser()
+    parser.add_argument("--trace", help="replay an existing trace; it must "
+                        "have been recorded on the --data array")
+    parser.add_argument("--data", help=".npy array the trace was recorded on")
+    parser.add_argument("--rows", type=int, default=5000)
+    parser.add_argument("--vars", type=int, default=20)
+    parser.add_argument("--scores", nargs="+",
+                        default=["gauss", "countsketch", "subsample"])
+    parser.add_argument("--sketch-rows", type=int, default=1000)
+    parser.add_argument("--seed", type=int, default=0)
+    args = parser.parse_args()
+
+    if args.data:
+        X = np.load(args.data)
+    else:
+        rng = np.random.default_rng(args.seed)
+        X = rng.normal(0, 1, [args.rows, args.vars])
+        X[:, 1:] += 0.8 * X[:, :-1]
+
+    trace_path = args.trace
+    if not trace_path:
+        trace_path = os.path.join(tempfile.mkdtemp(), "ges.trace")
+        start = time.perf_counter()
+        run_ges(X, trace_path=trace_path)
+        print(f"recorded {trace_path} in {time.perf_counter() - start:.2f}s")
+
+    print(f"{'score':>12} {'stream':>7} {'queries':>8} {'q/s':>10} "
+          f"{'p50[us]':>8} {'p90[us]':>8} {'p99[us]':>8} {'max[us]':>9} "
+          f"{'max diff':>9}")
+    for score in args.scores:
+        for misses_only in (False, True):
+            r = replay_trace(X, trace_path, score=score,
+                             misses_only=misses_only,
+                             sketch_rows=args.sketch_rows)
+            stream = "misses" if misses_only else "all"
+            print(f"{score:>12} {stream:>7} {r['queries']:8d} "
+                  f"{r['throughput']:10.0f} {r['p50_us']:8.1f} "
+                  f"{r['p90_us']:8.1f} {r['p99_us']:8.1f} "
+                  f"{r['max_us']:9.1f} {r['max_abs_diff']:9.3g}")
+    print(f"recorded cache hit rate {r['recorded_hit_rate']:.3f}")
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,17 @@
+# Synthetic data shared by the benchmark scripts
+import numpy as np
+
+
+# n rows of a linear Gaussian SEM on a random DAG of the given expected
+# degree; returns the adjacency of the true DAG and the data
+def random_sem(n, p, degree, rng):
+    order = rng.permutation(p)
+    W = np.zeros((p, p))
+    for a in range(p):
+        for b in range(a + 1, p):
+            if rng.random() < degree / (p - 1):
+                W[order[a], order[b]] = rng.uniform(0.5, 1.5) * rng.choice([-1, 1])
+    X = np.zeros((n, p))
+    for j in order:
+        X[:, j] = X @ W[:, j] + rng.normal(0, 1, n)
+    return W != 0, X
@@ -31,13 +31,6 @@ class CMakeBuild(build_ext):
 
         cfg = "Debug" if self.debug else "Release"
 
-        try:
-            import torch
-            torch_cmake_path = torch.utils.cmake_prefix_path
-        except Exception:
-            print("PyTorch not installed.")
-            exit(-1)
-
         py_version = ''.join(re.match(r"\d+.\d+", sys.version).group(0).split('.'))
 
         # Set Python_EXECUTABLE instead if you use PYBIND11_FINDPYTHON
@@ -48,9 +41,19 @@ class CMakeBuild(build_ext):
             "-DPYTHON_EXECUTABLE={}".format(sys.executable),
             "-DCMAKE_BUILD_TYPE={}".format(cfg),
             "-DPYTHON_INCLUDE_DIR={}".format(get_path('include')),  # not used on MSVC, but no harm
-            "-DTORCH_CMAKE_PATH={}".format(torch_cmake_path),
             "-DPYTHON_VERSION={}".format(py_version)
         ]
+        # The torch tensor adapter is optional; the core only needs BLAS/LAPACK
+        if os.environ.get("GESCPP_WITH_TORCH"):
+            try:
+                import torch
+            except Exception:
+                print("PyTorch not installed.")
+                exit(-1)
+            cmake_args += [
+                "-DGESCPP_WITH_TORCH=ON",
+                "-DTORCH_CMAKE_PATH={}".format(torch.utils.cmake_prefix_path)
+            ]
         print(cmake_args)
         build_args = []
 
@@ -4,132 +4,495 @@
 
 #ifndef GESCPP_DECOMPOSABLESCORE_H
 #define GESCPP_DECOMPOSABLESCORE_H
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <algorithm>
+#include <chrono>
 #include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <limits>
 #include <map>
-#include <set>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <shared_mutex>
+#include <string>
 #include <tuple>
 #include <utility>
 #include <vector>
-#include "torch/torch.h"
+#include "Matrix.h"
+#include "NodeSet.h"
+#include "trace.h"
+
+// Storage precision of the data of a Gaussian score. Single keeps the
+// centered data in float32; sums accumulate and solves run in float64.
+enum class Precision { Double, Single };
 
 class DecomposableScore {
    protected:
     bool cache = true;
     int debug = 0;
     std::map<std::vector<int>, double> _cache;
+    std::vector<int> _key;
+    // Cache entries added since the last take_cache_journal()
+    bool _journaling = false;
+    std::vector<std::pair<std::vector<int>, double>> _journal;
+    std::shared_ptr<trace::Recorder> _trace;
+
+    // FNV-1a, used to fingerprint the data and parameters of a score
+    static std::uint64_t _hash_bytes(
+        const void* bytes,
+        std::size_t size,
+        std::uint64_t h = 14695981039346656037ull) {
+        auto ptr = reinterpret_cast<const unsigned char*>(bytes);
+        for (std::size_t i = 0; i < size; ++i) {
+            h ^= ptr[i];
+            h *= 1099511628211ull;
+        }
+        return h;
+    }
+
+    // Gain bound of an L0-penalized Gaussian score, whose likelihood term
+    // only depends on the residual variance. Extra regressors never increase
+    // the residual variance, so the gain is at most the likelihood ratio
+    // between base and base + T0 + {x}.
+    double _gauss_insert_gain_bound(int x,
+                                    int y,
+                                    const utils::NodeSet& base,
+                                    const utils::NodeSet& T0,
+                                    double lmbda) {
+        auto full = utils::set_union(base, T0);
+        full.insert(x);
+        return local_score(y, full) - local_score(y, base) +
+               lmbda * double(T0.size());
+    }
+
+    template <typename T>
+    static std::uint64_t _hash_matrix(const la::View<T>& m, std::uint64_t h) {
+        for (auto s : {m.rows(), m.cols()})
+            h = _hash_bytes(&s, sizeof(s), h);
+        return _hash_bytes(m.data(), m.rows() * m.cols() * sizeof(T), h);
+    }
+    static std::uint64_t _hash_matrix(const la::Matrix<double>& m,
+                                      std::uint64_t h) {
+        return _hash_matrix(m.view(), h);
+    }
 
    public:
+    // Cache file layout: header, then (key length, key, value) records
+    struct CacheFileHeader {
+        char magic[8];
+        std::uint32_t version;
+        std::uint32_t reserved;
+        std::uint64_t fingerprint;
+        std::uint64_t count;
+    };
+    static constexpr char cache_magic[8] = {'G', 'E', 'S', 'C',
+                                            'A', 'C', 'H', 'E'};
+    static constexpr std::uint32_t cache_version = 1;
+
+
     explicit DecomposableScore(bool cache = true, int debug = 0)
         : cache(cache), debug(debug) {}
 
-    double local_score(int x, const std::set<int>& pa) {
+    double local_score(int x, const utils::NodeSet& pa) {
         if (debug) {
             std::cout << x << "(";
             for (auto p : pa)
                 std::cout << "," << p;
             std::cout << ") :";
         }
+        std::chrono::steady_clock::time_point start;
+        if (_trace) start = std::chrono::steady_clock::now();
         double value;
+        bool hit = false;
         if (!cache) {
             value = _compute_local_score(x, pa);
         } else {
-            std::vector key = {x};
-            key.insert(key.end(), pa.begin(), pa.end());
-            if (_cache.find(key) != _cache.end()) {
+            // Reuse the key buffer so cache hits do not allocate
+            _key.assign(1, x);
+            _key.insert(_key.end(), pa.begin(), pa.end());
+            auto it = _cache.lower_bound(_key);
+            if (it != _cache.end() && it->first == _key) {
                 if (debug) std::cout << "using cached value ";
-                value = _cache[key];
+                value = it->second;
+                hit = true;
             } else {
-                value = _cache[key] = _compute_local_score(x, pa);
+                value = _compute_local_score(x, pa);
+                _cache.emplace_hint(it, _key, value);
+                if (_journaling) _journal.emplace_back(_key, value);
             }
         }
+        if (_trace)
+            _trace->record(x, pa, hit, std::chrono::steady_clock::now() - start,
+                           value);
         return value;
     }
 
     [[nodiscard]] virtual double _compute_local_score(
         int x,
-        const std::set<int>& pa) const {
+        const utils::NodeSet& pa) const {
         return 0.0;
     }
+
+    // Upper bound on local_score(y, base + T + {x}) - local_score(y, base + T)
+    // over all subsets T of T0; infinity means no bound is available
+    virtual double insert_gain_bound(int x,
+                                     int y,
+                                     const utils::NodeSet& base,
+                                     const utils::NodeSet& T0) {
+        return std::numeric_limits<double>::infinity();
+    }
+
+    void clear_cache() { _cache.clear(); }
+
+    // Records every local_score query to a trace file, see trace.h. Copies
+    // of the score made while recording append to the same trace.
+    void record_trace(const std::string& path) {
+        _trace = std::make_shared<trace::Recorder>(path, fingerprint());
+    }
+
+    void stop_trace() {
+        if (_trace) _trace->flush();
+        _trace.reset();
+    }
+
+    // Score of a DAG, the sum of the local scores of its nodes
+    double full_score(const la::Matrix<int64_t>& dag) {
+        int p = (int)dag.rows();
+        double score = 0;
+        for (int j = 0; j < p; ++j) {
+            utils::NodeSet pa;
+            for (int i = 0; i < p; ++i)
+                if (dag(i, j) != 0) pa.insert(i);
+            score += local_score(j, pa);
+        }
+        return score;
+    }
+
+    // Identifies the data and score parameters; cache files only load into
+    // a score with the same fingerprint
+    [[nodiscard]] virtual std::uint64_t fingerprint() const { return 0; }
+
+    bool save_cache(const std::string& path) const {
+        return write_cache(path, fingerprint(), _cache);
+    }
+
+    // Copy of the cache that can be written while the search goes on
+    [[nodiscard]] std::map<std::vector<int>, double> cache_snapshot() const {
+        return _cache;
+    }
+
+    // While journaling, new cache entries are also kept aside, so a writer
+    // holding an earlier snapshot can catch up without copying the cache
+    void journal_cache(bool on) {
+        _journaling = on;
+        _journal.clear();
+    }
+    std::vector<std::pair<std::vector<int>, double>> take_cache_journal() {
+        return std::exchange(_journal, {});
+    }
+
+    static bool write_cache(const std::string& path,
+                            std::uint64_t fingerprint,
+                            const std::map<std::vector<int>, double>& entries) {
+        auto tmp_path = path + ".tmp";
+        std::ofstream out(tmp_path, std::ios::binary | std::ios::trunc);
+        if (!out) return false;
+        CacheFileHeader header{};
+        std::memcpy(header.magic, cache_magic, sizeof(cache_magic));
+        header.version = cache_version;
+        header.fingerprint = fingerprint;
+        header.count = entries.size();
+        out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        std::vector<std::int32_t> key;
+        for (const auto& [k, value] : entries) {
+            key.assign(k.begin(), k.end());
+            auto key_len = std::uint32_t(key.size());
+            out.write(reinterpret_cast<const char*>(&key_len), sizeof(key_len));
+            out.write(reinterpret_cast<const char*>(key.data()),
+                      std::streamsize(key.size() * sizeof(std::int32_t)));
+            out.write(reinterpret_cast<const char*>(&value), sizeof(value));
+        }
+        out.close();
+        if (!out) return false;
+        return std::rename(tmp_path.c_str(), path.c_str()) == 0;
+    }
+
+    // Merges a cache file into the cache; returns false if the file is
+    // missing, malformed or was written for other data or parameters
+    bool load_cache(const std::string& path) {
+        int fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0) return false;
+        struct stat st {};
+        if (::fstat(fd, &st) != 0 ||
+            std::size_t(st.st_size) < sizeof(CacheFileHeader)) {
+            ::close(fd);
+            return false;
+        }
+        auto size = std::size_t(st.st_size);
+        void* mapped = ::mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+        ::close(fd);
+        if (mapped == MAP_FAILED) return false;
+
+        auto begin = static_cast<const char*>(mapped);
+        auto end = begin + size;
+        CacheFileHeader header{};
+        std::memcpy(&header, begin, sizeof(header));
+        bool ok = std::memcmp(header.magic, cache_magic,
+                              sizeof(cache_magic)) == 0 &&
+                  header.version == cache_version &&
+                  header.fingerprint == fingerprint();
+
+        std::vector<std::pair<std::vector<int>, double>> entries;
+        auto pos = begin + sizeof(header);
+        for (std::uint64_t i = 0; ok && i < header.count; ++i) {
+            std::uint32_t key_len;
+            if (std::size_t(end - pos) < sizeof(key_len)) {
+                ok = false;
+                break;
+            }
+            std::memcpy(&key_len, pos, sizeof(key_len));
+            pos += sizeof(key_len);
+            auto record_size = key_len * sizeof(std::int32_t) + sizeof(double);
+            if (std::size_t(end - pos) < record_size) {
+                ok = false;
+                break;
+            }
+            std::vector<int> key(key_len);
+            for (std::uint32_t k = 0; k < key_len; ++k) {
+                std::int32_t v;
+                std::memcpy(&v, pos + k * sizeof(v), sizeof(v));
+                key[k] = v;
+            }
+            pos += key_len * sizeof(std::int32_t);
+            double value;
+            std::memcpy(&value, pos, sizeof(value));
+            pos += sizeof(value);
+            entries.emplace_back(std::move(key), value);
+        }
+        ::munmap(mapped, size);
+        if (!ok) return false;
+
+        // Records are written in key order
+        for (auto& [key, value] : entries)
+            _cache.emplace_hint(_cache.end(), std::move(key), value);
+        return true;
+    }
+};
+
+// Penalty-free local likelihoods, shared between scores on the same data
+// that differ only in lmbda; safe to use from several threads
+class LikelihoodCache {
+   public:
+    template <typename F>
+    double get(int x, const utils::NodeSet& pa, F&& compute) {
+        std::vector<int> key{x};
+        key.insert(key.end(), pa.begin(), pa.end());
+        {
+            std::shared_lock lock(mutex);
+            auto it = values.find(key);
+            if (it != values.end()) return it->second;
+        }
+        auto value = compute();
+        std::unique_lock lock(mutex);
+        values.emplace(std::move(key), value);
+        return value;
+    }
+
+   private:
+    std::shared_mutex mutex;
+    std::map<std::vector<int>, double> values;
 };
 
 class GaussObsL0Pen : public DecomposableScore {
    public:
-    torch::Tensor data, _centered;
+    // Centered data, one variable per row (p x n), in memory kept alive by
+    // _storage and shared by all copies of the score. Only the view of the
+    // score's precision is set.
+    la::View<double> _columns{nullptr, 0, 0};
+    la::View<float> _columns32{nullptr, 0, 0};
+    std::shared_ptr<const void> _storage;
     int n, p;
     double lmbda;
+    Precision precision;
+    std::shared_ptr<LikelihoodCache> likelihoods;
 
-    explicit GaussObsL0Pen(torch::Tensor _data,
+    explicit GaussObsL0Pen(const la::Matrix<double>& data,
                            bool cache = true,
-                           int debug = 0)
-        : data(std::move(_data)), DecomposableScore(cache, debug) {
-        n = data.size(0);
+                           int debug = 0,
+                           Precision precision = Precision::Double)
+        : GaussObsL0Pen(data.view(), cache, debug, precision) {}
+
+    // Only the centered columns are kept; data may be a view of a numpy
+    // array
+    explicit GaussObsL0Pen(const la::View<double>& data,
+                           bool cache = true,
+                           int debug = 0,
+                           Precision precision = Precision::Double)
+        : precision(precision), DecomposableScore(cache, debug) {
+        if (precision == Precision::Single) {
+            auto columns = std::make_shared<la::Matrix<float>>(
+                la::centered_columns<float>(data));
+            _columns32 = columns->view();
+            _storage = columns;
+        } else {
+            auto columns = std::make_shared<la::Matrix<double>>(
+                la::centered_columns(data));
+            _columns = columns->view();
+            _storage = columns;
+        }
+        n = (int)data.rows();
         lmbda = 0.5 * log(n);
-        p = data.size(1);
-        _centered = data - data.mean(0);
+        p = (int)data.cols();
     }
 
-    [[nodiscard]] double _compute_local_score(int x, const std::set<int>& pa)
-        const override {
-        torch::Tensor sigma;
-        sigma = _mle_local(x, pa);
-        auto likelihood = -0.5 * n * (1.0 + torch::log(sigma));
-        auto l0_term = lmbda * double(pa.size() + 1);
-        auto score = likelihood.item().toDouble() - l0_term;
+    // Score on centered columns (p x n) held elsewhere, e.g. in shared
+    // memory; storage keeps them alive
+    static GaussObsL0Pen from_columns(const la::View<double>& columns,
+                                      std::shared_ptr<const void> storage,
+                                      bool cache = true,
+                                      int debug = 0) {
+        GaussObsL0Pen score(cache, debug);
+        score._columns = columns;
+        score._storage = std::move(storage);
+        score.n = (int)columns.cols();
+        score.lmbda = 0.5 * log(score.n);
+        score.p = (int)columns.rows();
         return score;
     }
 
-    [[nodiscard]] torch::Tensor _mle_local(int j,
-                                           const std::set<int>& parents) const {
-        std::vector<int> parents_vec{parents.begin(), parents.end()};
-        auto parents_torch = torch::tensor(parents_vec);
-        auto Y = _centered.index({"...", j});
-        torch::Tensor sigma;
-        if (!parents.empty()) {
-            auto X = torch::atleast_2d(_centered.index({"...", parents_torch}));
-            auto [coef, u1, u2, u3] =
-                torch::linalg::lstsq(X, Y, c10::nullopt, c10::nullopt);
-            sigma = torch::var(Y - torch::matmul(X, coef));
-        } else {
-            sigma = torch::var(Y);
+    [[nodiscard]] std::uint64_t fingerprint() const override {
+        const char tag[] = "GaussObsL0Pen";
+        auto h = _hash_bytes(tag, sizeof(tag));
+        h = _hash_bytes(&lmbda, sizeof(lmbda), h);
+        if (precision == Precision::Single)
+            return _hash_matrix(_columns32, h);
+        return _hash_matrix(_columns, h);
+    }
+
+    double insert_gain_bound(int x,
+                             int y,
+                             const utils::NodeSet& base,
+                             const utils::NodeSet& T0) override {
+        return _gauss_insert_gain_bound(x, y, base, T0, lmbda);
+    }
+
+    [[nodiscard]] double _compute_local_score(int x, const utils::NodeSet& pa)
+        const override {
+        auto l0_term = lmbda * double(pa.size() + 1);
+        if (likelihoods) {
+            return likelihoods->get(x, pa,
+                                    [&] { return _likelihood(x, pa); }) -
+                   l0_term;
         }
-        return sigma;
+        return _likelihood(x, pa) - l0_term;
+    }
+
+    [[nodiscard]] double _likelihood(int x, const utils::NodeSet& pa) const {
+        auto sigma = _mle_local(x, pa);
+        return -0.5 * n * (1.0 + std::log(sigma));
     }
+
+    [[nodiscard]] double _mle_local(int j,
+                                    const utils::NodeSet& parents) const {
+        if (precision == Precision::Single)
+            return la::residual_variances(_columns32, {j}, parents)[0];
+        auto residual = la::residuals(_columns, {j}, parents);
+        return la::variance(residual.row(0), n);
+    }
+
+   private:
+    GaussObsL0Pen(bool cache, int debug)
+        : precision(Precision::Double), DecomposableScore(cache, debug) {}
 };
 
 class GaussClusterL0Pen : public DecomposableScore {
    public:
-    torch::Tensor data, _centered;
+    // Empty in single precision, where only _columns32 is kept
+    la::Matrix<double> data;
+    // Centered data, one variable per row
+    la::Matrix<double> _columns;
+    la::Matrix<float> _columns32;
     int n, p;
     double lmbda;
+    Precision precision;
     std::vector<std::vector<int>> graph;
 
-    explicit GaussClusterL0Pen(torch::Tensor _data,
+    explicit GaussClusterL0Pen(la::Matrix<double> _data,
                                std::vector<std::vector<int>> graph,
                                bool cache = true,
-                               int debug = 0)
+                               int debug = 0,
+                               Precision precision = Precision::Double)
         : data(std::move(_data)),
+          precision(precision),
           DecomposableScore(cache, debug),
           graph(std::move(graph)) {
-        n = (int)data.size(0);
+        n = (int)data.rows();
         lmbda = 0.5 * log(n);
-        p = (int)data.size(1);
-        _centered = data - data.mean(0);
+        p = (int)data.cols();
+        if (precision == Precision::Single) {
+            _columns32 = la::centered_columns<float>(data.view());
+            data = {};
+        } else {
+            _columns = la::centered_columns(data.view());
+        }
+    }
+
+    [[nodiscard]] std::uint64_t fingerprint() const override {
+        const char tag[] = "GaussClusterL0Pen";
+        auto h = _hash_bytes(tag, sizeof(tag));
+        h = _hash_bytes(&lmbda, sizeof(lmbda), h);
+        for (const auto& cluster : graph) {
+            auto size = cluster.size();
+            h = _hash_bytes(&size, sizeof(size), h);
+            h = _hash_bytes(cluster.data(), size * sizeof(int), h);
+        }
+        if (precision == Precision::Single)
+            return _hash_bytes(_columns32.data(),
+                               _columns32.size() * sizeof(float), h);
+        return _hash_matrix(data, h);
     }
 
-    [[nodiscard]] double _compute_local_score(int x, const std::set<int>& pa)
+    [[nodiscard]] double _compute_local_score(int x, const utils::NodeSet& pa)
         const override {
-        auto x_single = graph[x];
-        std::set<int> pa_single;
+        const auto& x_single = graph[x];
+        utils::NodeSet pa_single;
         for (auto i : pa) {
             for (auto j : graph[i]) {
                 pa_single.insert(j);
             }
         }
 
+        // Collect the members whose score is not cached for this parent set
+        std::vector<int> key{0};
+        key.insert(key.end(), pa_single.begin(), pa_single.end());
         double max_score = -1e10;
+        std::vector<int> missing;
         for (auto i : x_single) {
-            auto result = _compute_single_local_score(i, pa_single);
-            max_score = std::max(max_score, result);
+            key[0] = i;
+            auto it = _member_cache.find(key);
+            if (it != _member_cache.end())
+                max_score = std::max(max_score, it->second);
+            else
+                missing.emplace_back(i);
+        }
+        if (missing.empty()) return max_score;
+
+        // All members share the same design matrix, so solve once for all
+        auto sigma = _mle_local_multi(missing, pa_single);
+        auto l0_term = lmbda * double(pa_single.size() + 1);
+        for (int k = 0; k < missing.size(); ++k) {
+            auto score = -0.5 * n * (1.0 + std::log(sigma[k])) - l0_term;
+            key[0] = missing[k];
+            if (cache) _member_cache[key] = score;
+            max_score = std::max(max_score, score);
         }
 
         return max_score;
@@ -137,31 +500,489 @@ class GaussClusterL0Pen : public DecomposableScore {
 
     [[nodiscard]] double _compute_single_local_score(
         int x,
-        const std::set<int>& pa) const {
-        torch::Tensor sigma;
-        sigma = _mle_local(x, pa);
-        auto likelihood = -0.5 * n * (1.0 + torch::log(sigma));
+        const utils::NodeSet& pa) const {
+        auto sigma = _mle_local(x, pa);
+        auto likelihood = -0.5 * n * (1.0 + std::log(sigma));
         auto l0_term = lmbda * double(pa.size() + 1);
-        auto score = likelihood.item().toDouble() - l0_term;
+        auto score = likelihood - l0_term;
         return score;
     }
 
-    [[nodiscard]] torch::Tensor _mle_local(int j,
-                                           const std::set<int>& parents) const {
-        std::vector<int> parents_vec{parents.begin(), parents.end()};
-        auto parents_torch = torch::tensor(parents_vec);
-        auto Y = _centered.index({"...", j});
-        torch::Tensor sigma;
-        if (!parents.empty()) {
-            auto X = torch::atleast_2d(_centered.index({"...", parents_torch}));
-            auto [coef, u1, u2, u3] =
-                torch::linalg::lstsq(X, Y, c10::nullopt, c10::nullopt);
-            sigma = torch::var(Y - torch::matmul(X, coef));
-        } else {
-            sigma = torch::var(Y);
-        }
+    [[nodiscard]] double _mle_local(int j,
+                                    const utils::NodeSet& parents) const {
+        return _mle_local_multi({j}, parents)[0];
+    }
+
+    // Residual variances of the columns in js regressed on the same parents
+    [[nodiscard]] std::vector<double> _mle_local_multi(
+        const std::vector<int>& js,
+        const utils::NodeSet& parents) const {
+        if (precision == Precision::Single)
+            return la::residual_variances(_columns32.view(), js, parents);
+        auto residual = la::residuals(_columns.view(), js, parents);
+        std::vector<double> sigma(js.size());
+        for (int k = 0; k < js.size(); ++k)
+            sigma[k] = la::variance(residual.row(k), n);
         return sigma;
     }
+
+   private:
+    // Member-level scores keyed by (member, expanded parent set)
+    mutable std::map<std::vector<int>, double> _member_cache;
+};
+
+// Gaussian score for data from several environments with known intervention
+// targets. Only per-environment covariances are kept. The local score of a
+// node pools the environments in which it was not intervened on, so scoring
+// costs do not depend on the number of rows.
+class GaussIntL0Pen : public DecomposableScore {
+   public:
+    std::vector<la::Matrix<double>> covs;
+    std::vector<double> ns;
+    std::vector<std::vector<int>> interventions;
+    int p;
+    double lmbda;
+
+    // covs[e]: maximum likelihood covariance of environment e, estimated
+    // from ns[e] rows; interventions[e]: nodes intervened on in e
+    GaussIntL0Pen(std::vector<la::Matrix<double>> _covs,
+                  std::vector<double> _ns,
+                  std::vector<std::vector<int>> _interventions,
+                  bool cache = true,
+                  int debug = 0)
+        : covs(std::move(_covs)),
+          ns(std::move(_ns)),
+          interventions(std::move(_interventions)),
+          DecomposableScore(cache, debug) {
+        if (covs.empty()) throw "Need at least one environment";
+        if (ns.size() != covs.size() || interventions.size() != covs.size())
+            throw "Need one size and one target list per environment";
+        p = (int)covs[0].rows();
+        for (int e = 0; e < covs.size(); ++e) {
+            if (covs[e].rows() != p || covs[e].cols() != p)
+                throw "Environments have different numbers of variables";
+            for (auto t : interventions[e])
+                if (t < 0 || t >= p) throw "Intervention target out of range";
+        }
+        double n_total = 0;
+        for (auto n : ns)
+            n_total += n;
+        lmbda = 0.5 * log(n_total);
+
+        // Nodes intervened on in the same environments share one pooled
+        // covariance
+        std::map<std::vector<bool>, int> groups;
+        group.resize(p);
+        for (int j = 0; j < p; ++j) {
+            std::vector<bool> observed(covs.size(), true);
+            for (int e = 0; e < covs.size(); ++e)
+                for (auto t : interventions[e])
+                    if (t == j) observed[e] = false;
+            auto [it, inserted] = groups.emplace(observed, pooled.size());
+            group[j] = it->second;
+            if (!inserted) continue;
+            la::Matrix<double> S(p, p);
+            double n_obs = 0;
+            for (int e = 0; e < covs.size(); ++e) {
+                if (!observed[e]) continue;
+                cblas_daxpy(int(S.size()), ns[e], covs[e].data(), 1, S.data(),
+                            1);
+                n_obs += ns[e];
+            }
+            if (n_obs > 0) cblas_dscal(int(S.size()), 1 / n_obs, S.data(), 1);
+            pooled.emplace_back(std::move(S));
+            pooled_n.emplace_back(n_obs);
+        }
+    }
+
+    // One [rows x p] array per environment
+    static GaussIntL0Pen from_data(
+        const std::vector<la::Matrix<double>>& datasets,
+        std::vector<std::vector<int>> interventions,
+        bool cache = true,
+        int debug = 0) {
+        std::vector<la::Matrix<double>> covs;
+        std::vector<double> ns;
+        for (const auto& X : datasets) {
+            auto mean = la::column_means(X.view());
+            auto centered = X;
+            for (int64_t i = 0; i < X.rows(); ++i)
+                cblas_daxpy(int(X.cols()), -1.0, mean.data(), 1,
+                            centered.row(i), 1);
+            auto n = double(X.rows());
+            la::Matrix<double> cov(X.cols(), X.cols());
+            la::add_gram(centered.data(), X.rows(), X.cols(), cov, 1 / n);
+            covs.emplace_back(std::move(cov));
+            ns.emplace_back(n);
+        }
+        return GaussIntL0Pen(std::move(covs), std::move(ns),
+                             std::move(interventions), cache, debug);
+    }
+
+    [[nodiscard]] std::uint64_t fingerprint() const override {
+        const char tag[] = "GaussIntL0Pen";
+        auto h = _hash_bytes(tag, sizeof(tag));
+        h = _hash_bytes(&lmbda, sizeof(lmbda), h);
+        for (int e = 0; e < covs.size(); ++e) {
+            h = _hash_matrix(covs[e], h);
+            h = _hash_bytes(&ns[e], sizeof(ns[e]), h);
+            auto size = interventions[e].size();
+            h = _hash_bytes(&size, sizeof(size), h);
+            h = _hash_bytes(interventions[e].data(), size * sizeof(int), h);
+        }
+        return h;
+    }
+
+    double insert_gain_bound(int x,
+                             int y,
+                             const utils::NodeSet& base,
+                             const utils::NodeSet& T0) override {
+        return _gauss_insert_gain_bound(x, y, base, T0, lmbda);
+    }
+
+    [[nodiscard]] double _compute_local_score(int x, const utils::NodeSet& pa)
+        const override {
+        auto l0_term = lmbda * double(pa.size() + 1);
+        auto n_obs = pooled_n[group[x]];
+        // Intervened on everywhere: the parents explain nothing
+        if (n_obs == 0) return -l0_term;
+        auto sigma = _mle_local(x, pa);
+        auto likelihood = -0.5 * n_obs * (1.0 + std::log(sigma));
+        return likelihood - l0_term;
+    }
+
+    // Residual variance of j given its parents under the pooled covariance
+    [[nodiscard]] double _mle_local(int j,
+                                    const utils::NodeSet& parents) const {
+        const auto& S = pooled[group[j]];
+        auto s_jj = S(j, j);
+        if (parents.empty()) return s_jj;
+        std::vector<int> pa{parents.begin(), parents.end()};
+        int k = (int)pa.size();
+        // S_pp is symmetric, so its row-major copy is also column-major
+        std::vector<double> S_pp(std::size_t(k) * k), S_pj(k), coef(k);
+        for (int a = 0; a < k; ++a) {
+            for (int b = 0; b < k; ++b)
+                S_pp[std::size_t(a) * k + b] = S(pa[a], pa[b]);
+            S_pj[a] = coef[a] = S(pa[a], j);
+        }
+        la::lstsq(k, k, 1, S_pp.data(), coef.data(), k);
+        return s_jj - cblas_ddot(k, S_pj.data(), 1, coef.data(), 1);
+    }
+
+   private:
+    std::vector<int> group;
+    std::vector<la::Matrix<double>> pooled;
+    std::vector<double> pooled_n;
+};
+
+// BIC score for categorical data. Values are recoded per column to
+// 0..arity-1. The rows are sorted and collapsed into distinct rows with
+// multiplicities, stored column by column, so a contingency count for
+// (y, parents) scans the distinct rows instead of all n rows.
+class DiscreteBIC : public DecomposableScore {
+   public:
+    int n, p;
+    double lmbda;
+    std::vector<int> arities;
+    // columns[j][u]: code of variable j in distinct row u
+    std::vector<std::vector<std::uint16_t>> columns;
+    std::vector<double> weights;
+
+    // data: n x p values in row-major order
+    DiscreteBIC(const std::vector<std::int64_t>& data,
+                int n,
+                int p,
+                bool cache = true,
+                int debug = 0)
+        : n(n), p(p), DecomposableScore(cache, debug) {
+        lmbda = 0.5 * log(n);
+
+        // Recode every column to 0..arity-1
+        std::vector<std::uint16_t> codes(std::size_t(n) * p);
+        arities.resize(p);
+        for (int j = 0; j < p; ++j) {
+            std::vector<std::int64_t> values(n);
+            for (int i = 0; i < n; ++i)
+                values[i] = data[std::size_t(i) * p + j];
+            std::sort(values.begin(), values.end());
+            values.erase(std::unique(values.begin(), values.end()),
+                         values.end());
+            if (values.size() > 65535) throw "Too many categories";
+            arities[j] = std::max(1, (int)values.size());
+            for (int i = 0; i < n; ++i) {
+                auto v = data[std::size_t(i) * p + j];
+                codes[std::size_t(i) * p + j] = std::uint16_t(
+                    std::lower_bound(values.begin(), values.end(), v) -
+                    values.begin());
+            }
+        }
+
+        // Sort the rows and collapse duplicates
+        std::vector<int> rows(n);
+        for (int i = 0; i < n; ++i)
+            rows[i] = i;
+        auto row = [&](int i) { return codes.data() + std::size_t(i) * p; };
+        std::sort(rows.begin(), rows.end(), [&](int a, int b) {
+            return std::lexicographical_compare(row(a), row(a) + p, row(b),
+                                                row(b) + p);
+        });
+        columns.assign(p, {});
+        for (int k = 0; k < n; ++k) {
+            if (k > 0 && std::equal(row(rows[k]), row(rows[k]) + p,
+                                    row(rows[k - 1]))) {
+                weights.back() += 1;
+                continue;
+            }
+            for (int j = 0; j < p; ++j)
+                columns[j].emplace_back(row(rows[k])[j]);
+            weights.emplace_back(1);
+        }
+    }
+
+    [[nodiscard]] std::uint64_t fingerprint() const override {
+        const char tag[] = "DiscreteBIC";
+        auto h = _hash_bytes(tag, sizeof(tag));
+        h = _hash_bytes(&lmbda, sizeof(lmbda), h);
+        for (const auto& column : columns)
+            h = _hash_bytes(column.data(),
+                            column.size() * sizeof(std::uint16_t), h);
+        return _hash_bytes(weights.data(), weights.size() * sizeof(double), h);
+    }
+
+    // The log-likelihood never decreases with extra parents, and the
+    // penalty of adding x is smallest on the base set
+    double insert_gain_bound(int x,
+                             int y,
+                             const utils::NodeSet& base,
+                             const utils::NodeSet& T0) override {
+        auto full = utils::set_union(base, T0);
+        full.insert(x);
+        auto q_base = _configurations(base), q_full = _configurations(full);
+        return local_score(y, full) - local_score(y, base) +
+               lmbda * (arities[y] - 1) * (q_full - q_base * arities[x]);
+    }
+
+    [[nodiscard]] double _compute_local_score(int x, const utils::NodeSet& pa)
+        const override {
+        auto q = _configurations(pa);
+        auto l0_term = lmbda * q * double(arities[x] - 1);
+        return _log_likelihood(x, pa) - l0_term;
+    }
+
+    // Number of joint parent configurations
+    [[nodiscard]] double _configurations(const utils::NodeSet& pa) const {
+        double q = 1;
+        for (auto j : pa)
+            q *= arities[j];
+        return q;
+    }
+
+    // Multinomial log-likelihood sum_jk N_jk log(N_jk / N_j)
+    [[nodiscard]] double _log_likelihood(int x,
+                                         const utils::NodeSet& pa) const {
+        auto distinct = weights.size();
+        auto r = arities[x];
+        const auto& x_codes = columns[x];
+        std::vector<int> parents{pa.begin(), pa.end()};
+        auto q = _configurations(pa);
+        double likelihood = 0;
+
+        if (q * r <= double(std::max<std::size_t>(distinct, 1 << 16))) {
+            // Dense contingency table indexed by (parent configuration, x)
+            std::vector<double> counts(std::size_t(q) * r, 0.0);
+            for (std::size_t u = 0; u < distinct; ++u) {
+                std::size_t config = 0;
+                for (auto j : parents)
+                    config = config * arities[j] + columns[j][u];
+                counts[config * r + x_codes[u]] += weights[u];
+            }
+            for (std::size_t config = 0; config < std::size_t(q); ++config) {
+                double total = 0;
+                for (int k = 0; k < r; ++k)
+                    total += counts[config * r + k];
+                for (int k = 0; k < r; ++k) {
+                    auto c = counts[config * r + k];
+                    if (c > 0) likelihood += c * std::log(c / total);
+                }
+            }
+            return likelihood;
+        }
+
+        // Too many configurations for a table: sort the distinct rows by
+        // parent configuration and x, then sweep
+        std::vector<std::size_t> order(distinct);
+        for (std::size_t u = 0; u < distinct; ++u)
+            order[u] = u;
+        auto less = [&](std::size_t a, std::size_t b) {
+            for (auto j : parents)
+                if (columns[j][a] != columns[j][b])
+                    return columns[j][a] < columns[j][b];
+            return x_codes[a] < x_codes[b];
+        };
+        auto same_parents = [&](std::size_t a, std::size_t b) {
+            for (auto j : parents)
+                if (columns[j][a] != columns[j][b]) return false;
+            return true;
+        };
+        std::sort(order.begin(), order.end(), less);
+        std::size_t begin = 0;
+        while (begin < distinct) {
+            auto end = begin;
+            double total = 0;
+            while (end < distinct && same_parents(order[begin], order[end]))
+                total += weights[order[end++]];
+            for (auto k = begin; k < end;) {
+                double c = 0;
+                auto code = x_codes[order[k]];
+                while (k < end && x_codes[order[k]] == code)
+                    c += weights[order[k++]];
+                likelihood += c * std::log(c / total);
+            }
+            begin = end;
+        }
+        return likelihood;
+    }
+};
+
+// Approximate Gaussian score for very tall data. The centered data is
+// compressed once into a k x p sketch S X with E||S r||^2 = ||r||^2, and
+// every regression runs on the k sketch rows. The likelihood keeps the
+// scale of all n rows.
+class GaussSketchL0Pen : public DecomposableScore {
+   public:
+    enum class Method { CountSketch, Subsample };
+
+    // Sketch accuracy: with probability 1 - delta, eps bounds the relative
+    // error of every residual sum of squares the score computes, at once
+    // (CountSketch only, NaN otherwise); observed_error is the largest
+    // relative error of the squared norms of the data columns
+    struct ErrorReport {
+        int k;
+        double delta, eps, observed_error, score_error_bound;
+    };
+
+    // Sketch of the centered data, one variable per row: p x k
+    la::Matrix<double> sketch;
+    int n, p, k;
+    double lmbda;
+    Method method;
+
+    GaussSketchL0Pen(const la::View<double>& data,
+                     int k,
+                     Method method = Method::CountSketch,
+                     std::uint64_t seed = 0,
+                     bool cache = true,
+                     int debug = 0)
+        : k(k), method(method), DecomposableScore(cache, debug) {
+        n = (int)data.rows();
+        p = (int)data.cols();
+        // The sketch is scored as a sample of k rows: the noise of sketched
+        // residual norms only shrinks with k, so scaling the likelihood to
+        // n rows would let spurious parents outgrow the BIC penalty
+        lmbda = 0.5 * log(k);
+        if (k < 2 || k > n) throw "Sketch size must be in [2, n]";
+
+        // One pass over the rows. The sketch of the centered data is
+        // S X - (S 1) mean^T, so the mean is subtracted at the end.
+        std::mt19937_64 rng(seed);
+        std::vector<double> sum(p, 0.0), sum_sq(p, 0.0), S1(k, 0.0);
+        la::Matrix<double> SX(k, p);
+        // Subsample: one uniform row per stratum of n / k consecutive rows
+        std::vector<int64_t> picks;
+        if (method == Method::Subsample) {
+            for (int64_t b = 0; b < k; ++b) {
+                int64_t lo = b * n / k, hi = (b + 1) * n / k;
+                picks.emplace_back(lo + int64_t(rng() % (hi - lo)));
+            }
+        }
+        double scale = std::sqrt(double(n) / k);
+        auto pick = picks.begin();
+        for (int64_t i = 0; i < n; ++i) {
+            auto x = data.row(i);
+            for (int j = 0; j < p; ++j) {
+                sum[j] += x[j];
+                sum_sq[j] += x[j] * x[j];
+            }
+            if (method == Method::CountSketch) {
+                auto bits = rng();
+                auto bucket = int64_t((bits >> 1) % std::uint64_t(k));
+                auto sign = (bits & 1) ? 1.0 : -1.0;
+                cblas_daxpy(p, sign, x, 1, SX.row(bucket), 1);
+                S1[bucket] += sign;
+            } else if (pick != picks.end() && *pick == i) {
+                auto row = pick - picks.begin();
+                cblas_daxpy(p, scale, x, 1, SX.row(row), 1);
+                S1[row] = scale;
+                ++pick;
+            }
+        }
+        sketch = la::Matrix<double>(p, k);
+        _column_norms.resize(p);
+        for (int j = 0; j < p; ++j) {
+            auto mean = sum[j] / double(n);
+            for (int r = 0; r < k; ++r)
+                sketch(j, r) = SX(r, j) - S1[r] * mean;
+            // Exact squared norms of the centered columns, for the report
+            _column_norms[j] = sum_sq[j] - double(n) * mean * mean;
+        }
+    }
+
+    [[nodiscard]] std::uint64_t fingerprint() const override {
+        const char tag[] = "GaussSketchL0Pen";
+        auto h = _hash_bytes(tag, sizeof(tag));
+        h = _hash_bytes(&lmbda, sizeof(lmbda), h);
+        h = _hash_bytes(&n, sizeof(n), h);
+        return _hash_matrix(sketch, h);
+    }
+
+    [[nodiscard]] ErrorReport error_report(double delta = 0.05) const {
+        double observed = 0;
+        for (int j = 0; j < p; ++j) {
+            auto sketched = cblas_ddot(k, sketch.row(j), 1, sketch.row(j), 1);
+            observed = std::max(observed,
+                                std::abs(sketched - _column_norms[j]) /
+                                    std::max(_column_norms[j], 1e-300));
+        }
+        // CountSketch with k >= (d^2 + d) / (eps^2 delta) rows is an eps
+        // subspace embedding of a d-dimensional subspace (Nelson & Nguyen).
+        // The centered columns span at most p dimensions, so the squared
+        // norm of every residual, over all queries together, is kept within
+        // 1 +- eps. Minimizing over the coefficients carries this over to
+        // least squares residuals fitted on the sketch.
+        auto eps = method == Method::CountSketch
+                       ? std::sqrt((double(p) * p + p) / (k * delta))
+                       : std::numeric_limits<double>::quiet_NaN();
+        auto e = std::isnan(eps) ? observed : eps;
+        auto score_bound = e < 1 ? 0.5 * k * std::log((1 + e) / (1 - e))
+                                 : std::numeric_limits<double>::infinity();
+        return {k, delta, eps, observed, score_bound};
+    }
+
+    double insert_gain_bound(int x,
+                             int y,
+                             const utils::NodeSet& base,
+                             const utils::NodeSet& T0) override {
+        return _gauss_insert_gain_bound(x, y, base, T0, lmbda);
+    }
+
+    [[nodiscard]] double _compute_local_score(int x, const utils::NodeSet& pa)
+        const override {
+        auto sigma = _mle_local(x, pa);
+        auto likelihood = -0.5 * k * (1.0 + std::log(sigma));
+        auto l0_term = lmbda * double(pa.size() + 1);
+        return likelihood - l0_term;
+    }
+
+    // Residual variance estimated from the sketched residual norm
+    [[nodiscard]] double _mle_local(int j,
+                                    const utils::NodeSet& parents) const {
+        auto residual = la::residuals(sketch.view(), {j}, parents);
+        return cblas_ddot(k, residual.row(0), 1, residual.row(0), 1) / (n - 1);
+    }
+
+   private:
+    std::vector<double> _column_norms;
 };
 
 #endif  // GESCPP_DECOMPOSABLESCORE_H
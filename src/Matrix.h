@@ -0,0 +1,235 @@
+#ifndef GESCPP_MATRIX_H
+#define GESCPP_MATRIX_H
+#include <cblas.h>
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <vector>
+
+// LAPACK, Fortran calling convention
+extern "C" void dgelsy_(const int* m,
+                        const int* n,
+                        const int* nrhs,
+                        double* a,
+                        const int* lda,
+                        double* b,
+                        const int* ldb,
+                        int* jpvt,
+                        const double* rcond,
+                        int* rank,
+                        double* work,
+                        const int* lwork,
+                        int* info);
+
+// Dense row-major matrices and the few BLAS/LAPACK routines the scores need
+namespace la {
+// Non-owning row-major view, e.g. of a numpy array
+template <typename T>
+class View {
+   public:
+    View(const T* data, int64_t rows, int64_t cols)
+        : ptr(data), n_rows(rows), n_cols(cols) {}
+
+    [[nodiscard]] int64_t rows() const { return n_rows; }
+    [[nodiscard]] int64_t cols() const { return n_cols; }
+    [[nodiscard]] const T* data() const { return ptr; }
+    [[nodiscard]] const T* row(int64_t i) const { return ptr + i * n_cols; }
+    const T& operator()(int64_t i, int64_t j) const {
+        return ptr[i * n_cols + j];
+    }
+
+   private:
+    const T* ptr;
+    int64_t n_rows, n_cols;
+};
+
+// Row-major matrix with value semantics: copies are deep
+template <typename T>
+class Matrix {
+   public:
+    Matrix() = default;
+    Matrix(int64_t rows, int64_t cols, T value = T())
+        : n_rows(rows), n_cols(cols), values(rows * cols, value) {}
+
+    static Matrix from_data(const T* data, int64_t rows, int64_t cols) {
+        Matrix result;
+        result.n_rows = rows;
+        result.n_cols = cols;
+        result.values.assign(data, data + rows * cols);
+        return result;
+    }
+
+    [[nodiscard]] int64_t rows() const { return n_rows; }
+    [[nodiscard]] int64_t cols() const { return n_cols; }
+    [[nodiscard]] int64_t size() const { return n_rows * n_cols; }
+    [[nodiscard]] bool empty() const { return values.empty(); }
+    T* data() { return values.data(); }
+    [[nodiscard]] const T* data() const { return values.data(); }
+    T* row(int64_t i) { return values.data() + i * n_cols; }
+    [[nodiscard]] const T* row(int64_t i) const {
+        return values.data() + i * n_cols;
+    }
+    T& operator()(int64_t i, int64_t j) { return values[i * n_cols + j]; }
+    const T& operator()(int64_t i, int64_t j) const {
+        return values[i * n_cols + j];
+    }
+    [[nodiscard]] View<T> view() const { return {data(), n_rows, n_cols}; }
+
+    [[nodiscard]] Matrix transpose() const {
+        Matrix result(n_cols, n_rows);
+        for (int64_t i = 0; i < n_rows; ++i)
+            for (int64_t j = 0; j < n_cols; ++j)
+                result(j, i) = (*this)(i, j);
+        return result;
+    }
+
+    friend bool operator==(const Matrix& a, const Matrix& b) {
+        return a.n_rows == b.n_rows && a.n_cols == b.n_cols &&
+               a.values == b.values;
+    }
+
+   private:
+    int64_t n_rows = 0, n_cols = 0;
+    std::vector<T> values;
+};
+
+// Column means of a rows x cols matrix
+inline std::vector<double> column_means(const View<double>& X) {
+    std::vector<double> mean(X.cols(), 0.0);
+    for (int64_t i = 0; i < X.rows(); ++i)
+        cblas_daxpy(int(X.cols()), 1.0, X.row(i), 1, mean.data(), 1);
+    for (auto& m : mean)
+        m /= double(std::max<int64_t>(X.rows(), 1));
+    return mean;
+}
+
+// The columns of X minus their means, one variable per row: cols x rows.
+// Each variable is contiguous, so a design matrix is a copy of a few rows.
+// The means are subtracted in double before any rounding to T.
+template <typename T = double>
+Matrix<T> centered_columns(const View<double>& X) {
+    auto mean = column_means(X);
+    Matrix<T> result(X.cols(), X.rows());
+    for (int64_t i = 0; i < X.rows(); ++i)
+        for (int64_t j = 0; j < X.cols(); ++j)
+            result(j, i) = T(X(i, j) - mean[j]);
+    return result;
+}
+
+// C += alpha Z^T Z for a rows x cols row-major Z; C is cols x cols
+inline void add_gram(const double* Z,
+                     int64_t rows,
+                     int64_t cols,
+                     Matrix<double>& C,
+                     double alpha = 1.0) {
+    if (rows == 0) return;
+    cblas_dsyrk(CblasRowMajor, CblasUpper, CblasTrans, int(cols), int(rows),
+                alpha, Z, int(cols), 1.0, C.data(), int(cols));
+    for (int64_t i = 0; i < cols; ++i)
+        for (int64_t j = 0; j < i; ++j)
+            C(i, j) = C(j, i);
+}
+
+// Minimum norm least squares solution of A X = B through a complete
+// orthogonal factorization (LAPACK dgelsy), as numpy and torch do. A is
+// m x n and B is m x nrhs, both column-major; both are overwritten and the
+// solution is left in the first n rows of B, so ldb >= max(m, n).
+inline void lstsq(int m, int n, int nrhs, double* A, double* B, int ldb) {
+    int lda = std::max(1, m), rank, info, lwork = -1;
+    double rcond = std::numeric_limits<double>::epsilon() * std::max(m, n);
+    std::vector<int> jpvt(n, 0);
+    double query;
+    dgelsy_(&m, &n, &nrhs, A, &lda, B, &ldb, jpvt.data(), &rcond, &rank,
+            &query, &lwork, &info);
+    lwork = std::max(1, int(query));
+    std::vector<double> work(lwork);
+    dgelsy_(&m, &n, &nrhs, A, &lda, B, &ldb, jpvt.data(), &rcond, &rank,
+            work.data(), &lwork, &info);
+    if (info != 0) throw "Least squares solve failed";
+}
+
+// Residuals of the rows ys of a variables x samples matrix regressed on the
+// rows xs, one residual vector per row of the result
+template <typename Range>
+Matrix<double> residuals(const View<double>& vars,
+                         const std::vector<int>& ys,
+                         const Range& xs) {
+    int n = int(vars.cols()), m = int(ys.size());
+    Matrix<double> result(m, n);
+    for (int r = 0; r < m; ++r)
+        std::memcpy(result.row(r), vars.row(ys[r]), n * sizeof(double));
+    std::vector<int> parents(xs.begin(), xs.end());
+    int k = int(parents.size());
+    if (k == 0) return result;
+
+    // Both operands of dgelsy are column-major, i.e. one variable per
+    // contiguous block, which is the layout of vars
+    std::vector<double> A(std::size_t(n) * k);
+    for (int c = 0; c < k; ++c)
+        std::memcpy(A.data() + std::size_t(c) * n, vars.row(parents[c]),
+                    n * sizeof(double));
+    int ldb = std::max(n, k);
+    std::vector<double> B(std::size_t(ldb) * m, 0.0);
+    for (int r = 0; r < m; ++r)
+        std::memcpy(B.data() + std::size_t(r) * ldb, vars.row(ys[r]),
+                    n * sizeof(double));
+    lstsq(n, k, m, A.data(), B.data(), ldb);
+    for (int r = 0; r < m; ++r)
+        for (int c = 0; c < k; ++c)
+            cblas_daxpy(n, -B[std::size_t(r) * ldb + c], vars.row(parents[c]),
+                        1, result.row(r), 1);
+    return result;
+}
+
+// Residual variances as above for single precision data, through the
+// normal equations: inner products accumulate in double (dsdot) and the
+// small k x k system is solved in double. Residual sums of squares are
+// floored at the resolution of float data relative to ||y||^2.
+template <typename Range>
+std::vector<double> residual_variances(const View<float>& vars,
+                                       const std::vector<int>& ys,
+                                       const Range& xs) {
+    int n = int(vars.cols()), m = int(ys.size());
+    auto dot = [&](int a, int b) {
+        return cblas_dsdot(n, vars.row(a), 1, vars.row(b), 1);
+    };
+    std::vector<int> parents(xs.begin(), xs.end());
+    int k = int(parents.size());
+    std::vector<double> Xy(std::size_t(k) * m), B, G(std::size_t(k) * k);
+    for (int a = 0; a < k; ++a) {
+        for (int b = 0; b <= a; ++b)
+            G[std::size_t(a) * k + b] = G[std::size_t(b) * k + a] =
+                dot(parents[a], parents[b]);
+        for (int r = 0; r < m; ++r)
+            Xy[std::size_t(r) * k + a] = dot(parents[a], ys[r]);
+    }
+    B = Xy;
+    if (k > 0) lstsq(k, k, m, G.data(), B.data(), k);
+
+    auto eps = double(std::numeric_limits<float>::epsilon());
+    std::vector<double> result(m);
+    for (int r = 0; r < m; ++r) {
+        auto yy = dot(ys[r], ys[r]);
+        auto rss = yy;
+        for (int a = 0; a < k; ++a)
+            rss -= Xy[std::size_t(r) * k + a] * B[std::size_t(r) * k + a];
+        result[r] = std::max(rss, yy * eps * eps) / double(n - 1);
+    }
+    return result;
+}
+
+// Unbiased sample variance
+inline double variance(const double* x, int64_t n) {
+    double mean = 0;
+    for (int64_t i = 0; i < n; ++i)
+        mean += x[i];
+    mean /= double(n);
+    double ss = 0;
+    for (int64_t i = 0; i < n; ++i)
+        ss += (x[i] - mean) * (x[i] - mean);
+    return ss / double(n - 1);
+}
+}  // namespace la
+
+#endif  // GESCPP_MATRIX_H
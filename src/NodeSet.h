@@ -0,0 +1,221 @@
+#ifndef GESCPP_NODESET_H
+#define GESCPP_NODESET_H
+#include <algorithm>
+#include <cstddef>
+#include <cstring>
+#include <initializer_list>
+#include <iterator>
+#include <memory>
+#include <utility>
+#include <vector>
+
+namespace utils {
+// Bump allocator backing the node sets of one search step
+class NodeArena {
+   public:
+    int* allocate(std::size_t count) {
+        while (block < blocks.size() && offset + count > sizes[block]) {
+            ++block;
+            offset = 0;
+        }
+        if (block == blocks.size()) {
+            auto size = std::max(count, block_size);
+            blocks.emplace_back(new int[size]);
+            sizes.emplace_back(size);
+            offset = 0;
+        }
+        auto ptr = blocks[block].get() + offset;
+        offset += count;
+        return ptr;
+    }
+
+    void reset() { block = offset = 0; }
+
+    static NodeArena*& current() {
+        static thread_local NodeArena* arena = nullptr;
+        return arena;
+    }
+
+    // Routes the node set allocations of a step to this thread's arena. The
+    // outermost scope resets the arena, so no set may outlive its step.
+    class Scope {
+       public:
+        Scope() : previous(current()) {
+            static thread_local NodeArena arena;
+            if (!previous) {
+                arena.reset();
+                current() = &arena;
+            }
+        }
+        ~Scope() { current() = previous; }
+        Scope(const Scope&) = delete;
+        Scope& operator=(const Scope&) = delete;
+
+       private:
+        NodeArena* previous;
+    };
+
+   private:
+    static constexpr std::size_t block_size = 1 << 16;
+    std::vector<std::unique_ptr<int[]>> blocks;
+    std::vector<std::size_t> sizes;
+    std::size_t block = 0, offset = 0;
+};
+
+// Sorted set of node indices with inline storage. Larger sets spill to the
+// current step arena, or to the heap outside of a step. Sets are move-only;
+// use clone() for an explicit copy.
+class NodeSet {
+   public:
+    using value_type = int;
+    using const_iterator = const int*;
+    static constexpr int inline_capacity = 14;
+
+    NodeSet() = default;
+    NodeSet(std::initializer_list<int> nodes) {
+        insert(nodes.begin(), nodes.end());
+    }
+    template <typename It>
+    NodeSet(It first, It last) {
+        insert(first, last);
+    }
+    NodeSet(const NodeSet&) = delete;
+    NodeSet& operator=(const NodeSet&) = delete;
+    NodeSet(NodeSet&& other) noexcept { steal(other); }
+    NodeSet& operator=(NodeSet&& other) noexcept {
+        if (this != &other) {
+            release();
+            steal(other);
+        }
+        return *this;
+    }
+    ~NodeSet() { release(); }
+
+    [[nodiscard]] NodeSet clone() const {
+        NodeSet result;
+        result.reserve(count);
+        std::copy(begin(), end(), result.nodes);
+        result.count = count;
+        return result;
+    }
+
+    [[nodiscard]] const int* begin() const { return nodes; }
+    [[nodiscard]] const int* end() const { return nodes + count; }
+    [[nodiscard]] std::size_t size() const { return count; }
+    [[nodiscard]] bool empty() const { return count == 0; }
+
+    [[nodiscard]] const int* find(int v) const {
+        auto it = std::lower_bound(begin(), end(), v);
+        return it != end() && *it == v ? it : end();
+    }
+    [[nodiscard]] bool contains(int v) const { return find(v) != end(); }
+
+    void reserve(int n) {
+        if (n <= capacity) return;
+        auto new_capacity = std::max(n, 2 * capacity);
+        auto arena = NodeArena::current();
+        auto new_nodes =
+            arena ? arena->allocate(new_capacity) : new int[new_capacity];
+        std::copy(begin(), end(), new_nodes);
+        release();
+        nodes = new_nodes;
+        capacity = new_capacity;
+        if (!arena) heap = new_nodes;
+    }
+
+    void insert(int v) {
+        if (count == 0 || nodes[count - 1] < v) {
+            reserve(count + 1);
+            nodes[count++] = v;
+            return;
+        }
+        auto it = std::lower_bound(nodes, nodes + count, v);
+        if (*it == v) return;
+        auto pos = it - nodes;
+        reserve(count + 1);
+        std::memmove(nodes + pos + 1, nodes + pos,
+                     (count - pos) * sizeof(int));
+        nodes[pos] = v;
+        ++count;
+    }
+
+    void push_back(int v) { insert(v); }
+
+    template <typename It>
+    void insert(It first, It last) {
+        for (; first != last; ++first)
+            insert(int(*first));
+    }
+
+    void erase(int v) {
+        auto it = std::lower_bound(nodes, nodes + count, v);
+        if (it == nodes + count || *it != v) return;
+        std::memmove(it, it + 1, (nodes + count - it - 1) * sizeof(int));
+        --count;
+    }
+
+    void clear() { count = 0; }
+
+    friend bool operator==(const NodeSet& a, const NodeSet& b) {
+        return std::equal(a.begin(), a.end(), b.begin(), b.end());
+    }
+
+   private:
+    int local[inline_capacity];
+    int* nodes = local;
+    int count = 0, capacity = inline_capacity;
+    // Equal to nodes when the nodes live on the heap
+    int* heap = nullptr;
+
+    void release() {
+        delete[] heap;
+        heap = nullptr;
+        nodes = local;
+        capacity = inline_capacity;
+    }
+
+    void steal(NodeSet& other) {
+        count = other.count;
+        if (other.nodes == other.local) {
+            std::copy(other.local, other.local + count, local);
+            nodes = local;
+            capacity = inline_capacity;
+            heap = nullptr;
+        } else {
+            nodes = other.nodes;
+            capacity = other.capacity;
+            heap = other.heap;
+            other.nodes = other.local;
+            other.capacity = inline_capacity;
+            other.heap = nullptr;
+        }
+        other.count = 0;
+    }
+};
+
+inline NodeSet set_union(const NodeSet& a, const NodeSet& b) {
+    NodeSet result;
+    result.reserve(int(a.size() + b.size()));
+    std::set_union(a.begin(), a.end(), b.begin(), b.end(),
+                   std::back_inserter(result));
+    return result;
+}
+
+inline NodeSet set_intersection(const NodeSet& a, const NodeSet& b) {
+    NodeSet result;
+    result.reserve(int(std::min(a.size(), b.size())));
+    std::set_intersection(a.begin(), a.end(), b.begin(), b.end(),
+                          std::back_inserter(result));
+    return result;
+}
+
+inline NodeSet set_difference(const NodeSet& a, const NodeSet& b) {
+    NodeSet result;
+    result.reserve(int(a.size()));
+    std::set_difference(a.begin(), a.end(), b.begin(), b.end(),
+                        std::back_inserter(result));
+    return result;
+}
+}  // namespace utils
+
+#endif  // GESCPP_NODESET_H
@@ -0,0 +1,174 @@
+#ifndef GESCPP_CHECKPOINT_H
+#define GESCPP_CHECKPOINT_H
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <future>
+#include <map>
+#include <string>
+#include <utility>
+#include <vector>
+#include "DecomposableScore.h"
+#include "utils.h"
+
+namespace ges {
+// State of a fit between two accepted operators
+struct FitState {
+    utils::Graph A;
+    int iteration = 0;
+    int phase = 0;
+    double total_score = 0;
+    double last_total_score = 0;
+};
+
+// Where and how often fit() writes checkpoints. The score cache is stored
+// next to the checkpoint when with_cache is set.
+struct Checkpoint {
+    std::string path;
+    int every = 1;
+    bool with_cache = false;
+};
+
+struct CheckpointFileHeader {
+    char magic[8];
+    std::uint32_t version;
+    std::uint32_t p;
+    std::uint64_t fingerprint;
+    std::int32_t iteration;
+    std::int32_t phase;
+    double total_score;
+    double last_total_score;
+};
+constexpr char checkpoint_magic[8] = {'G', 'E', 'S', 'C', 'K', 'P', 'T', 0};
+constexpr std::uint32_t checkpoint_version = 1;
+
+inline std::string checkpoint_cache_path(const std::string& path) {
+    return path + ".cache";
+}
+
+inline bool write_checkpoint(const std::string& path,
+                             std::uint64_t fingerprint,
+                             const FitState& state) {
+    const auto& A = state.A;
+    CheckpointFileHeader header{};
+    std::memcpy(header.magic, checkpoint_magic, sizeof(checkpoint_magic));
+    header.version = checkpoint_version;
+    header.p = std::uint32_t(A.rows());
+    header.fingerprint = fingerprint;
+    header.iteration = state.iteration;
+    header.phase = state.phase;
+    header.total_score = state.total_score;
+    header.last_total_score = state.last_total_score;
+
+    // Write aside and rename, so a crash never leaves a torn checkpoint
+    auto tmp_path = path + ".tmp";
+    std::ofstream out(tmp_path, std::ios::binary | std::ios::trunc);
+    if (!out) return false;
+    out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    out.write(reinterpret_cast<const char*>(A.data()),
+              std::streamsize(A.size() * sizeof(int64_t)));
+    out.close();
+    if (!out) return false;
+    return std::rename(tmp_path.c_str(), path.c_str()) == 0;
+}
+
+// Returns false if the file is missing, malformed or was written for a
+// score with another fingerprint
+inline bool read_checkpoint(const std::string& path,
+                            std::uint64_t fingerprint,
+                            FitState& state) {
+    std::ifstream in(path, std::ios::binary);
+    if (!in) return false;
+    CheckpointFileHeader header{};
+    in.read(reinterpret_cast<char*>(&header), sizeof(header));
+    if (!in ||
+        std::memcmp(header.magic, checkpoint_magic, sizeof(checkpoint_magic)) ||
+        header.version != checkpoint_version ||
+        header.fingerprint != fingerprint)
+        return false;
+    utils::Graph A(header.p, header.p);
+    in.read(reinterpret_cast<char*>(A.data()),
+            std::streamsize(A.size() * sizeof(int64_t)));
+    if (!in) return false;
+
+    state.A = std::move(A);
+    state.iteration = header.iteration;
+    state.phase = header.phase;
+    state.total_score = header.total_score;
+    state.last_total_score = header.last_total_score;
+    return true;
+}
+
+// Writes checkpoints of a fit in the background from snapshots of its
+// state. At most one write is in flight; the next one waits for it. The
+// writer keeps its own copy of the score cache, taken once, and the search
+// only hands it the entries added since the last checkpoint.
+class Checkpointer {
+   public:
+    Checkpointer(Checkpoint options, DecomposableScore& score)
+        : options(std::move(options)),
+          score(score),
+          // Hashing the data is not free; only needed when checkpointing
+          fingerprint(this->options.path.empty() ? 0
+                                                  : score.fingerprint()) {
+        if (this->options.path.empty() || !this->options.with_cache) return;
+        cache = score.cache_snapshot();
+        score.journal_cache(true);
+    }
+    Checkpointer(const Checkpointer&) = delete;
+    Checkpointer& operator=(const Checkpointer&) = delete;
+    ~Checkpointer() {
+        wait();
+        if (options.with_cache) score.journal_cache(false);
+    }
+
+    // Called after every accepted operator
+    void accepted(const FitState& state) {
+        if (options.path.empty()) return;
+        if (++since_last < std::max(1, options.every)) return;
+        since_last = 0;
+        save(state);
+    }
+
+    void save(const FitState& state) {
+        if (options.path.empty()) return;
+        if (!wait()) throw "Checkpoint write failed";
+        FitState snapshot = state;
+        std::vector<std::pair<std::vector<int>, double>> added;
+        if (options.with_cache) added = score.take_cache_journal();
+        pending = std::async(
+            std::launch::async,
+            [path = options.path, fingerprint = fingerprint,
+             snapshot = std::move(snapshot), added = std::move(added),
+             cache = options.with_cache ? &cache : nullptr]() mutable {
+                // The cache goes first: the checkpoint is the commit point
+                if (cache) {
+                    for (auto& [key, value] : added)
+                        cache->emplace(std::move(key), value);
+                    if (!DecomposableScore::write_cache(
+                            checkpoint_cache_path(path), fingerprint, *cache))
+                        return false;
+                }
+                return write_checkpoint(path, fingerprint, snapshot);
+            });
+    }
+
+    // Waits for the write in flight; returns false if it failed
+    bool wait() {
+        if (!pending.valid()) return true;
+        return pending.get();
+    }
+
+   private:
+    Checkpoint options;
+    DecomposableScore& score;
+    std::uint64_t fingerprint;
+    int since_last = 0;
+    std::future<bool> pending;
+    // Written by the write in flight only
+    std::map<std::vector<int>, double> cache;
+};
+}  // namespace ges
+
+#endif  // GESCPP_CHECKPOINT_H
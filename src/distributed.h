@@ -0,0 +1,563 @@
+#ifndef GESCPP_DISTRIBUTED_H
+#define GESCPP_DISTRIBUTED_H
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+#include "DecomposableScore.h"
+#include "ges.h"
+#include "knowledge.h"
+#include "utils.h"
+
+// Multi-process operator scoring. A coordinator running ges::fit shards the
+// operators of every step over worker processes and reduces their best
+// operators. The coordinator puts the centered data in one shared memory
+// segment, which workers on the same machine map and score in place; other
+// workers receive a copy over the connection.
+//
+// Addresses are "unix:<path>" or "tcp:<host>:<port>"; both transports carry
+// the same length-prefixed messages.
+namespace dist {
+enum class MessageType : std::uint8_t { Init, Ready, Step, Result, Shutdown };
+enum class StepKind : std::uint8_t { Forward, Backward };
+
+// Append-only message encoder
+class Writer {
+   public:
+    template <typename T>
+    void put(const T& value) {
+        static_assert(std::is_trivially_copyable_v<T>);
+        auto ptr = reinterpret_cast<const char*>(&value);
+        bytes.append(ptr, sizeof(T));
+    }
+    template <typename T>
+    void put_vector(const std::vector<T>& values) {
+        put_array(values.data(), values.size());
+    }
+    // Same encoding as put_vector
+    template <typename T>
+    void put_array(const T* values, std::size_t count) {
+        put<std::uint64_t>(count);
+        bytes.append(reinterpret_cast<const char*>(values), count * sizeof(T));
+    }
+    void put_string(const std::string& value) {
+        put<std::uint64_t>(value.size());
+        bytes.append(value);
+    }
+    void put_matrix(const utils::Graph& M) {
+        put<std::int64_t>(M.rows());
+        put<std::int64_t>(M.cols());
+        bytes.append(reinterpret_cast<const char*>(M.data()),
+                     M.size() * sizeof(int64_t));
+    }
+    void put_constraints(const ges::Constraints& constraints) {
+        put<std::int32_t>(constraints.p);
+        put_vector(constraints.parents);
+        put_vector(constraints.adjacent);
+    }
+
+    std::string bytes;
+};
+
+class Reader {
+   public:
+    explicit Reader(const std::string& bytes) : bytes(bytes) {}
+
+    template <typename T>
+    T get() {
+        static_assert(std::is_trivially_copyable_v<T>);
+        T value;
+        take(&value, sizeof(T));
+        return value;
+    }
+    template <typename T>
+    std::vector<T> get_vector() {
+        std::vector<T> values(get<std::uint64_t>());
+        take(values.data(), values.size() * sizeof(T));
+        return values;
+    }
+    std::string get_string() {
+        std::string value(get<std::uint64_t>(), '\0');
+        take(value.data(), value.size());
+        return value;
+    }
+    utils::Graph get_matrix() {
+        auto rows = get<std::int64_t>(), cols = get<std::int64_t>();
+        utils::Graph M(rows, cols);
+        take(M.data(), M.size() * sizeof(int64_t));
+        return M;
+    }
+    ges::Constraints get_constraints() {
+        ges::Constraints constraints;
+        constraints.p = get<std::int32_t>();
+        constraints.parents = get_vector<std::uint64_t>();
+        constraints.adjacent = get_vector<std::uint64_t>();
+        return constraints;
+    }
+
+   private:
+    void take(void* dst, std::size_t size) {
+        if (bytes.size() - pos < size) throw "Truncated message";
+        std::memcpy(dst, bytes.data() + pos, size);
+        pos += size;
+    }
+
+    const std::string& bytes;
+    std::size_t pos = 0;
+};
+
+// Bidirectional message channel between the coordinator and a worker
+class Transport {
+   public:
+    virtual ~Transport() = default;
+    virtual void send(const std::string& message) = 0;
+    virtual std::string recv() = 0;
+    // Whether the peer runs on this machine and can map shared memory
+    [[nodiscard]] virtual bool local() const = 0;
+};
+
+// Stream socket transport, used for both Unix domain and TCP sockets
+class SocketTransport : public Transport {
+   public:
+    SocketTransport(int fd, bool is_local) : fd(fd), is_local(is_local) {}
+    SocketTransport(const SocketTransport&) = delete;
+    SocketTransport& operator=(const SocketTransport&) = delete;
+    ~SocketTransport() override { ::close(fd); }
+
+    void send(const std::string& message) override {
+        std::uint64_t size = message.size();
+        write_all(&size, sizeof(size));
+        write_all(message.data(), message.size());
+    }
+
+    std::string recv() override {
+        std::uint64_t size;
+        read_all(&size, sizeof(size));
+        std::string message(size, '\0');
+        read_all(message.data(), size);
+        return message;
+    }
+
+    [[nodiscard]] bool local() const override { return is_local; }
+
+   private:
+    void write_all(const void* data, std::size_t size) {
+        auto ptr = static_cast<const char*>(data);
+        while (size > 0) {
+            auto written = ::send(fd, ptr, size, MSG_NOSIGNAL);
+            if (written < 0 && errno == EINTR) continue;
+            if (written <= 0) throw "Connection lost";
+            ptr += written;
+            size -= written;
+        }
+    }
+
+    void read_all(void* data, std::size_t size) {
+        auto ptr = static_cast<char*>(data);
+        while (size > 0) {
+            auto received = ::recv(fd, ptr, size, 0);
+            if (received < 0 && errno == EINTR) continue;
+            if (received <= 0) throw "Connection lost";
+            ptr += received;
+            size -= received;
+        }
+    }
+
+    int fd;
+    bool is_local;
+};
+
+struct Address {
+    bool is_unix;
+    std::string path, host, port;
+};
+
+inline Address parse_address(const std::string& address) {
+    if (address.rfind("unix:", 0) == 0) return {true, address.substr(5)};
+    if (address.rfind("tcp:", 0) == 0) {
+        auto rest = address.substr(4);
+        auto colon = rest.rfind(':');
+        if (colon == std::string::npos) throw "Invalid address";
+        return {false, "", rest.substr(0, colon), rest.substr(colon + 1)};
+    }
+    throw "Invalid address";
+}
+
+inline int tcp_socket(const Address& addr, bool passive) {
+    addrinfo hints{}, *res = nullptr;
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    if (passive) hints.ai_flags = AI_PASSIVE;
+    auto host = addr.host.empty() ? nullptr : addr.host.c_str();
+    if (::getaddrinfo(host, addr.port.c_str(), &hints, &res) != 0)
+        throw "Cannot resolve address";
+    int fd = -1;
+    for (auto ai = res; ai; ai = ai->ai_next) {
+        fd = ::socket(ai->ai_family, ai->ai_socktype, ai->ai_protocol);
+        if (fd < 0) continue;
+        int one = 1;
+        bool ok;
+        if (passive) {
+            ::setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+            ok = ::bind(fd, ai->ai_addr, ai->ai_addrlen) == 0 &&
+                 ::listen(fd, 16) == 0;
+        } else {
+            ok = ::connect(fd, ai->ai_addr, ai->ai_addrlen) == 0;
+            ::setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+        }
+        if (ok) break;
+        ::close(fd);
+        fd = -1;
+    }
+    ::freeaddrinfo(res);
+    return fd;
+}
+
+inline int unix_socket(const Address& addr, bool passive) {
+    sockaddr_un sa{};
+    sa.sun_family = AF_UNIX;
+    if (addr.path.size() >= sizeof(sa.sun_path)) throw "Socket path too long";
+    std::strncpy(sa.sun_path, addr.path.c_str(), sizeof(sa.sun_path) - 1);
+    int fd = ::socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0) return -1;
+    bool ok;
+    if (passive) {
+        ::unlink(addr.path.c_str());
+        ok = ::bind(fd, reinterpret_cast<sockaddr*>(&sa), sizeof(sa)) == 0 &&
+             ::listen(fd, 16) == 0;
+    } else {
+        ok = ::connect(fd, reinterpret_cast<sockaddr*>(&sa), sizeof(sa)) == 0;
+    }
+    if (!ok) {
+        ::close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+// Connects to a worker, retrying while it starts up
+inline std::unique_ptr<Transport> connect(const std::string& address,
+                                          double timeout_seconds = 30.0) {
+    auto addr = parse_address(address);
+    auto deadline = std::chrono::steady_clock::now() +
+                    std::chrono::duration<double>(timeout_seconds);
+    while (true) {
+        int fd = addr.is_unix ? unix_socket(addr, false)
+                              : tcp_socket(addr, false);
+        if (fd >= 0) return std::make_unique<SocketTransport>(fd, addr.is_unix);
+        if (std::chrono::steady_clock::now() > deadline)
+            throw "Cannot connect to worker";
+        std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    }
+}
+
+class Listener {
+   public:
+    explicit Listener(const std::string& address)
+        : addr(parse_address(address)) {
+        fd = addr.is_unix ? unix_socket(addr, true) : tcp_socket(addr, true);
+        if (fd < 0) throw "Cannot listen on address";
+    }
+    Listener(const Listener&) = delete;
+    Listener& operator=(const Listener&) = delete;
+    ~Listener() {
+        ::close(fd);
+        if (addr.is_unix) ::unlink(addr.path.c_str());
+    }
+
+    std::unique_ptr<Transport> accept() {
+        while (true) {
+            int client = ::accept(fd, nullptr, nullptr);
+            if (client >= 0)
+                return std::make_unique<SocketTransport>(client, addr.is_unix);
+            if (errno != EINTR) throw "Cannot accept connection";
+        }
+    }
+
+   private:
+    Address addr;
+    int fd;
+};
+
+// Read-only view of, or owner of, a named POSIX shared memory segment
+class SharedMemory {
+   public:
+    // Creates a segment holding a copy of the given bytes
+    static SharedMemory create(const void* data, std::size_t size) {
+        static std::atomic<int> counter{0};
+        SharedMemory shm;
+        shm.name = "/gescpp-" + std::to_string(::getpid()) + "-" +
+                   std::to_string(counter++);
+        int fd = ::shm_open(shm.name.c_str(), O_CREAT | O_EXCL | O_RDWR, 0600);
+        if (fd < 0) throw "Cannot create shared memory";
+        shm.owner = true;
+        if (::ftruncate(fd, off_t(std::max<std::size_t>(size, 1))) != 0) {
+            ::close(fd);
+            throw "Cannot create shared memory";
+        }
+        shm.map(fd, std::max<std::size_t>(size, 1), PROT_READ | PROT_WRITE);
+        std::memcpy(shm.addr, data, size);
+        return shm;
+    }
+
+    static SharedMemory open(const std::string& name, std::size_t size) {
+        SharedMemory shm;
+        shm.name = name;
+        int fd = ::shm_open(name.c_str(), O_RDONLY, 0);
+        if (fd < 0) throw "Cannot open shared memory";
+        struct stat info{};
+        if (::fstat(fd, &info) != 0 || std::size_t(info.st_size) < size) {
+            ::close(fd);
+            throw "Shared memory segment too small";
+        }
+        shm.map(fd, std::max<std::size_t>(size, 1), PROT_READ);
+        return shm;
+    }
+
+    SharedMemory() = default;
+    SharedMemory(const SharedMemory&) = delete;
+    SharedMemory& operator=(const SharedMemory&) = delete;
+    SharedMemory(SharedMemory&& other) noexcept { *this = std::move(other); }
+    SharedMemory& operator=(SharedMemory&& other) noexcept {
+        std::swap(name, other.name);
+        std::swap(addr, other.addr);
+        std::swap(size, other.size);
+        std::swap(owner, other.owner);
+        return *this;
+    }
+    ~SharedMemory() {
+        if (addr) ::munmap(addr, size);
+        unlink();
+    }
+
+    // Removes the name; existing mappings stay valid
+    void unlink() {
+        if (owner) ::shm_unlink(name.c_str());
+        owner = false;
+    }
+
+    std::string name;
+    void* addr = nullptr;
+    std::size_t size = 0;
+
+   private:
+    void map(int fd, std::size_t bytes, int prot) {
+        addr = ::mmap(nullptr, bytes, prot, MAP_SHARED, fd, 0);
+        ::close(fd);
+        if (addr == MAP_FAILED) {
+            addr = nullptr;
+            throw "Cannot map shared memory";
+        }
+        size = bytes;
+    }
+
+    bool owner = false;
+};
+
+// Scores the steps of a fit on remote workers, see ges::fit(..., executor)
+class Coordinator : public ges::StepExecutor {
+   public:
+    Coordinator(const std::vector<std::string>& addresses,
+                const GaussObsL0Pen& score) {
+        if (score.precision != Precision::Double)
+            throw "Workers need a double precision score";
+        // Workers score the centered columns (p x n) of the score
+        const auto& data = score._columns;
+        auto bytes = std::size_t(data.rows() * data.cols()) * sizeof(double);
+        for (const auto& address : addresses)
+            workers.emplace_back(connect(address));
+
+        bool any_local = false;
+        for (const auto& worker : workers)
+            any_local = any_local || worker->local();
+        if (any_local) shm = SharedMemory::create(data.data(), bytes);
+
+        int nshards = int(workers.size());
+        for (int shard = 0; shard < nshards; ++shard) {
+            auto& worker = workers[shard];
+            Writer msg;
+            msg.put(MessageType::Init);
+            msg.put<std::int32_t>(shard);
+            msg.put<std::int32_t>(nshards);
+            msg.put<std::int64_t>(data.rows());
+            msg.put<std::int64_t>(data.cols());
+            msg.put<double>(score.lmbda);
+            msg.put<std::uint8_t>(worker->local());
+            if (worker->local()) {
+                msg.put_string(shm.name);
+            } else {
+                msg.put_array(data.data(),
+                              std::size_t(data.rows() * data.cols()));
+            }
+            worker->send(msg.bytes);
+        }
+        for (auto& worker : workers) {
+            auto reply = worker->recv();
+            Reader in(reply);
+            if (in.get<MessageType>() != MessageType::Ready)
+                throw "Worker failed to start";
+        }
+        // Every worker has mapped the segment by now
+        shm.unlink();
+    }
+
+    ~Coordinator() override {
+        Writer msg;
+        msg.put(MessageType::Shutdown);
+        for (auto& worker : workers) {
+            try {
+                worker->send(msg.bytes);
+            } catch (...) {
+            }
+        }
+    }
+
+    ges::StepResult forward(const utils::Graph& A,
+                            int debug,
+                            const ges::Constraints& constraints,
+                            bool bounded) override {
+        Writer msg;
+        msg.put(MessageType::Step);
+        msg.put(StepKind::Forward);
+        msg.put<std::int32_t>(debug);
+        msg.put<std::uint8_t>(bounded);
+        msg.put_matrix(A);
+        msg.put_constraints(constraints);
+        return run(msg);
+    }
+
+    ges::StepResult backward(const utils::Graph& A,
+                             int debug,
+                             const ges::Constraints& constraints) override {
+        Writer msg;
+        msg.put(MessageType::Step);
+        msg.put(StepKind::Backward);
+        msg.put<std::int32_t>(debug);
+        msg.put<std::uint8_t>(false);
+        msg.put_matrix(A);
+        msg.put_constraints(constraints);
+        return run(msg);
+    }
+
+   private:
+    // Sends a step to every worker and reduces the per-shard best operators
+    ges::StepResult run(const Writer& msg) {
+        for (auto& worker : workers)
+            worker->send(msg.bytes);
+        ges::StepResult best;
+        for (auto& worker : workers) {
+            auto reply = worker->recv();
+            Reader in(reply);
+            if (in.get<MessageType>() != MessageType::Result)
+                throw "Unexpected message from worker";
+            ges::StepResult result;
+            result.score = in.get<double>();
+            result.op_cnt = in.get<std::int32_t>();
+            result.k = in.get<std::int32_t>();
+            result.x = in.get<std::int32_t>();
+            result.y = in.get<std::int32_t>();
+            result.T = in.get_vector<int>();
+            best.merge(result);
+        }
+        return best;
+    }
+
+    std::vector<std::unique_ptr<Transport>> workers;
+    SharedMemory shm;
+};
+
+// Serves one coordinator until it shuts the session down
+inline void serve(Transport& transport) {
+    auto init = transport.recv();
+    Reader in(init);
+    if (in.get<MessageType>() != MessageType::Init) throw "Expected init";
+    auto shard = in.get<std::int32_t>();
+    auto nshards = in.get<std::int32_t>();
+    // Centered columns, one variable per row
+    auto p = in.get<std::int64_t>(), n = in.get<std::int64_t>();
+    auto lmbda = in.get<double>();
+    if (p < 0 || n < 0) throw "Malformed init message";
+    auto count = std::size_t(p) * std::size_t(n);
+
+    // Local workers score the coordinator's segment in place; remote ones
+    // score their own copy
+    std::shared_ptr<const void> storage;
+    const double* columns;
+    if (in.get<std::uint8_t>()) {
+        auto shm = std::make_shared<SharedMemory>(
+            SharedMemory::open(in.get_string(), count * sizeof(double)));
+        columns = static_cast<const double*>(shm->addr);
+        storage = shm;
+    } else {
+        auto values = std::make_shared<std::vector<double>>(
+            in.get_vector<double>());
+        if (values->size() != count) throw "Malformed init message";
+        columns = values->data();
+        storage = values;
+    }
+    auto score =
+        GaussObsL0Pen::from_columns({columns, p, n}, std::move(storage));
+    score.lmbda = lmbda;
+    Writer ready;
+    ready.put(MessageType::Ready);
+    transport.send(ready.bytes);
+
+    while (true) {
+        auto request = transport.recv();
+        Reader step(request);
+        auto type = step.get<MessageType>();
+        if (type == MessageType::Shutdown) break;
+        if (type != MessageType::Step) throw "Unexpected message";
+        auto kind = step.get<StepKind>();
+        auto debug = step.get<std::int32_t>();
+        bool bounded = step.get<std::uint8_t>();
+        auto A = step.get_matrix();
+        auto constraints = step.get_constraints();
+        ges::StepResult result;
+        if (kind == StepKind::Forward) {
+            result = ges::score_forward(A, score, debug, constraints, bounded,
+                                        shard, nshards);
+        } else {
+            result = ges::score_backward(A, score, debug, constraints, shard,
+                                         nshards);
+        }
+        Writer reply;
+        reply.put(MessageType::Result);
+        reply.put<double>(result.score);
+        reply.put<std::int32_t>(result.op_cnt);
+        reply.put<std::int32_t>(result.k);
+        reply.put<std::int32_t>(result.x);
+        reply.put<std::int32_t>(result.y);
+        reply.put_vector(result.T);
+        transport.send(reply.bytes);
+    }
+}
+
+// Worker process main loop; sessions <= 0 serves coordinators forever
+inline void run_worker(const std::string& address, int sessions = 0) {
+    Listener listener(address);
+    for (int served = 0; sessions <= 0 || served < sessions; ++served) {
+        auto transport = listener.accept();
+        serve(*transport);
+    }
+}
+}  // namespace dist
+
+#endif  // GESCPP_DISTRIBUTED_H
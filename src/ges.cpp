@@ -1,10 +1,19 @@
 #include "ges.h"
 #include <boost/python/numpy.hpp>
 #include <boost/scoped_array.hpp>
+#include <fstream>
 #include <iostream>
+#include <memory>
 #include <vector>
 #include "DecomposableScore.h"
-#include "torch/torch.h"
+#include "distributed.h"
+#include "knowledge.h"
+#include "path.h"
+#include "trace.h"
+#include "utils.h"
+#ifdef GESCPP_WITH_TORCH
+#include "torch_adapter.h"
+#endif
 
 using namespace std;
 namespace p = boost::python;
@@ -46,21 +55,28 @@ np::ndarray wrap_count_and_sum(np::ndarray const& array) {
     return result;
 }
 
-torch::Tensor np_to_torch_double(const np::ndarray& array) {
+la::Matrix<double> np_to_matrix_double(const np::ndarray& array) {
     int s1 = array.shape(0), s2 = array.shape(1);
     auto narray = array.reshape(p::make_tuple(s1 * s2));
     double* arr_data = reinterpret_cast<double*>(narray.get_data());
-    auto result =
-        torch::tensor(std::vector<double>{arr_data, arr_data + s1 * s2});
-    result = result.reshape({s1, s2});
-    return result;
+    return la::Matrix<double>::from_data(arr_data, s1, s2);
+}
+
+// View of a C-contiguous array without copying; only valid while the array
+// is alive. Other arrays are copied into storage.
+la::View<double> np_as_view_double(const np::ndarray& array,
+                                   la::Matrix<double>& storage) {
+    if (!(array.get_flags() & np::ndarray::C_CONTIGUOUS)) {
+        storage = np_to_matrix_double(array);
+        return storage.view();
+    }
+    return {reinterpret_cast<const double*>(array.get_data()),
+            array.shape(0), array.shape(1)};
 }
 
-np::ndarray torch_to_np_int(const torch::Tensor& tensor_) {
-    int s1 = tensor_.size(0), s2 = tensor_.size(1);
-    auto tensor = tensor_.reshape({-1}).toType(torch::kInt).contiguous();
-    std::vector<int> vec{tensor.data_ptr<int>(),
-                         tensor.data_ptr<int>() + tensor.numel()};
+np::ndarray graph_to_np_int(const utils::Graph& graph) {
+    int s1 = graph.rows(), s2 = graph.cols();
+    std::vector<int> vec{graph.data(), graph.data() + graph.size()};
     auto dt = np::dtype::get_builtin<int>();
     auto shape = p::make_tuple(s1 * s2);
     auto new_shape = p::make_tuple(s1, s2);
@@ -71,8 +87,46 @@ np::ndarray torch_to_np_int(const torch::Tensor& tensor_) {
     return result;
 }
 
+// [(x, y), ...] as node pairs
+std::vector<std::pair<int, int>> list_to_pairs(const p::list& l) {
+    std::vector<std::pair<int, int>> pairs;
+    for (int i = 0; i < p::len(l); ++i) {
+        p::object pair = l[i];
+        if (p::len(pair) != 2) {
+            PyErr_SetString(PyExc_ValueError, "Expected pairs of nodes");
+            p::throw_error_already_set();
+        }
+        // Through int() so that numpy integers are accepted as well
+        pairs.emplace_back(p::extract<int>(p::long_(pair[0])),
+                           p::extract<int>(p::long_(pair[1])));
+    }
+    return pairs;
+}
+
+Precision parse_precision(const std::string& precision) {
+    if (precision == "single") return Precision::Single;
+    if (precision != "double") {
+        PyErr_SetString(PyExc_ValueError, "Unknown precision");
+        p::throw_error_already_set();
+    }
+    return Precision::Double;
+}
+
 // Run GES Wrapper (array: p x n)
-np::ndarray run_ges(const np::ndarray& array) {
+np::ndarray run_ges(const np::ndarray& array,
+                    const std::string& cache_path,
+                    bool bounded,
+                    const std::string& checkpoint_path,
+                    int checkpoint_every,
+                    bool checkpoint_cache,
+                    const p::list& workers,
+                    int max_lag,
+                    const std::string& trace_path,
+                    const std::string& precision,
+                    const p::list& tiers,
+                    const p::list& forbidden,
+                    const p::list& required,
+                    const p::list& required_adjacencies) {
     // Make sure we get doubles
     if (array.get_dtype() != np::dtype::get_builtin<double>()) {
         PyErr_SetString(PyExc_TypeError, "Incorrect array data type");
@@ -82,23 +136,119 @@ np::ndarray run_ges(const np::ndarray& array) {
         PyErr_SetString(PyExc_TypeError, "dim != 2");
         p::throw_error_already_set();
     }
-    // Convert np::ndarray to torch::Tensor
-    auto&& tensor = np_to_torch_double(array);
+    auto score_precision = parse_precision(precision);
+    std::unique_ptr<DecomposableScore> score_class;
+    ges::Knowledge knowledge;
+    auto n = array.shape(1);
+    if (max_lag > 0) {
+        // Time-series mode: score the lag-augmented covariance, read from
+        // the array in place, as a single observational environment
+        la::Matrix<double> storage;
+        auto X = np_as_view_double(array, storage);
+        auto cov = utils::lagged_covariance(X, max_lag);
+        std::vector<la::Matrix<double>> covs;
+        covs.emplace_back(std::move(cov));
+        score_class = std::make_unique<GaussIntL0Pen>(
+            std::move(covs), std::vector<double>{double(X.rows() - max_lag)},
+            std::vector<std::vector<int>>{{}});
+        // The lags are the tiers, so edges never point into the past
+        if (p::len(tiers) > 0) {
+            PyErr_SetString(PyExc_ValueError,
+                            "Time-series mode orders the lags as tiers");
+            p::throw_error_already_set();
+        }
+        knowledge.tiers = utils::lagged_tiers(X.cols(), max_lag);
+        n = X.cols() * (max_lag + 1);
+    } else {
+        // The score centers the columns straight from the array, in the
+        // precision it scores in
+        la::Matrix<double> storage;
+        score_class = std::make_unique<GaussObsL0Pen>(
+            np_as_view_double(array, storage), true, 0, score_precision);
+    }
+
+    // Background knowledge, compiled once for the whole search
+    for (int t = 0; t < p::len(tiers); ++t) {
+        p::object tier = tiers[t];
+        std::vector<int> nodes;
+        for (int i = 0; i < p::len(tier); ++i)
+            nodes.emplace_back(p::extract<int>(p::long_(tier[i])));
+        knowledge.tiers.emplace_back(std::move(nodes));
+    }
+    knowledge.forbidden = list_to_pairs(forbidden);
+    knowledge.required = list_to_pairs(required);
+    knowledge.required_adjacencies = list_to_pairs(required_adjacencies);
 
     // Run GES
-    auto n = tensor.size(1);
-    auto A0 = torch::zeros({n, n}).toType(torch::kLong);
-    auto score_class = GaussObsL0Pen(tensor);
-    auto&& [result, score] =
-        ges::fit(A0, score_class, {"forward", "backward"}, false, 0);
-
-    // Convert torch::Tensor to np::ndarray
-    auto&& result_np = torch_to_np_int(result);
+    utils::Graph A0(n, n);
+    ges::Constraints constraints;
+    try {
+        constraints = ges::Constraints(int(n), knowledge);
+        A0 = constraints.with_required(A0);
+    } catch (const char* message) {
+        PyErr_SetString(PyExc_ValueError, message);
+        p::throw_error_already_set();
+    }
+    if (!cache_path.empty()) score_class->load_cache(cache_path);
+    if (!trace_path.empty()) score_class->record_trace(trace_path);
+    ges::Checkpoint checkpoint{checkpoint_path, checkpoint_every,
+                               checkpoint_cache};
+    // Shard the operators of every step over the given worker processes
+    std::vector<std::string> addresses;
+    for (int i = 0; i < p::len(workers); ++i)
+        addresses.emplace_back(p::extract<std::string>(workers[i]));
+    std::unique_ptr<dist::Coordinator> coordinator;
+    if (!addresses.empty()) {
+        auto obs_score = dynamic_cast<GaussObsL0Pen*>(score_class.get());
+        if (!obs_score) {
+            PyErr_SetString(PyExc_ValueError,
+                            "Workers do not support time-series mode");
+            p::throw_error_already_set();
+        }
+        if (score_precision != Precision::Double) {
+            PyErr_SetString(PyExc_ValueError,
+                            "Workers need double precision");
+            p::throw_error_already_set();
+        }
+        coordinator =
+            std::make_unique<dist::Coordinator>(addresses, *obs_score);
+    }
+    // Continue from an existing checkpoint, otherwise start afresh
+    bool resume = !checkpoint_path.empty() &&
+                  std::ifstream(checkpoint_path, std::ios::binary).good();
+    ges::FitState state;
+    if (resume && !ges::read_checkpoint(checkpoint_path,
+                                        score_class->fingerprint(), state)) {
+        PyErr_SetString(PyExc_ValueError,
+                        "checkpoint_path holds a checkpoint of other data or "
+                        "settings, or a damaged one");
+        p::throw_error_already_set();
+    }
+    utils::Graph result;
+    try {
+        std::tie(result, std::ignore) =
+            resume ? ges::resume(*score_class, {"forward", "backward"}, false,
+                                 0, constraints, bounded, checkpoint,
+                                 coordinator.get())
+                   : ges::fit(A0, *score_class, {"forward", "backward"}, false,
+                              0, constraints, bounded, checkpoint,
+                              coordinator.get());
+    } catch (const char* message) {
+        PyErr_SetString(PyExc_RuntimeError, message);
+        p::throw_error_already_set();
+    }
+    if (!cache_path.empty()) score_class->save_cache(cache_path);
+    score_class->stop_trace();
+
+    // Convert utils::Graph to np::ndarray
+    auto&& result_np = graph_to_np_int(result);
     return result_np;
 }
 
 // Run GES Wrapper (array: p x n)
-np::ndarray run_cluster_ges(const np::ndarray& array, const p::list& l) {
+np::ndarray run_cluster_ges(const np::ndarray& array,
+                            const p::list& l,
+                            const std::string& cache_path) {
     // Make sure we get doubles
     if (array.get_dtype() != np::dtype::get_builtin<double>()) {
         PyErr_SetString(PyExc_TypeError, "Incorrect array data type");
@@ -122,26 +272,365 @@ np::ndarray run_cluster_ges(const np::ndarray& array, const p::list& l) {
         graph.emplace_back(node);
     }
 
-    // Convert np::ndarray to torch::Tensor
-    auto&& tensor = np_to_torch_double(array);
+    // Run GES
+    utils::Graph A0(l_len, l_len);
+    utils::Graph result;
+    try {
+        auto score_class = GaussClusterL0Pen(np_to_matrix_double(array), graph);
+        if (!cache_path.empty()) score_class.load_cache(cache_path);
+        std::tie(result, std::ignore) =
+            ges::fit(A0, score_class, {"forward", "backward"}, false, 0);
+        if (!cache_path.empty()) score_class.save_cache(cache_path);
+    } catch (const char* message) {
+        PyErr_SetString(PyExc_ValueError, message);
+        p::throw_error_already_set();
+    }
+
+    // Convert utils::Graph to np::ndarray
+    auto&& result_np = graph_to_np_int(result);
+    return result_np;
+}
+
+// Approximate GES on a k-row sketch of the data (array: n x p), followed by
+// an exact backward pass over the accepted edges; returns (graph, report)
+p::tuple run_sketched_ges(const np::ndarray& array,
+                          int sketch_rows,
+                          const std::string& method,
+                          std::uint64_t seed,
+                          bool refine) {
+    // Make sure we get doubles
+    if (array.get_dtype() != np::dtype::get_builtin<double>()) {
+        PyErr_SetString(PyExc_TypeError, "Incorrect array data type");
+        p::throw_error_already_set();
+    }
+    if (array.get_nd() != 2) {
+        PyErr_SetString(PyExc_TypeError, "dim != 2");
+        p::throw_error_already_set();
+    }
+    auto sketch_method = GaussSketchL0Pen::Method::CountSketch;
+    if (method == "subsample") {
+        sketch_method = GaussSketchL0Pen::Method::Subsample;
+    } else if (method != "countsketch") {
+        PyErr_SetString(PyExc_ValueError, "Unknown sketch method");
+        p::throw_error_already_set();
+    }
+    if (sketch_rows < 2 || sketch_rows > array.shape(0)) {
+        PyErr_SetString(PyExc_ValueError,
+                        "sketch_rows must be between 2 and the number of rows");
+        p::throw_error_already_set();
+    }
+
+    // The sketch is built from the array in place
+    la::Matrix<double> storage;
+    auto X = np_as_view_double(array, storage);
+    auto score_class = GaussSketchL0Pen(X, sketch_rows, sketch_method, seed);
+    utils::Graph A0(X.cols(), X.cols());
+    utils::Graph result;
+    try {
+        std::tie(result, std::ignore) =
+            ges::fit(A0, score_class, {"forward", "backward"}, false, 0);
+
+        // Rescore the accepted edges exactly and drop those that do not pay
+        // off. The exact score centers the array in place, without a raw
+        // copy.
+        if (refine) {
+            auto exact = GaussObsL0Pen(X);
+            std::tie(result, std::ignore) =
+                ges::fit(result, exact, {"backward"});
+        }
+    } catch (const char* message) {
+        PyErr_SetString(PyExc_ValueError, message);
+        p::throw_error_already_set();
+    }
+
+    auto report = score_class.error_report();
+    p::dict report_dict;
+    report_dict["sketch_rows"] = report.k;
+    report_dict["delta"] = report.delta;
+    report_dict["eps"] = report.eps;
+    report_dict["observed_error"] = report.observed_error;
+    report_dict["score_error_bound"] = report.score_error_bound;
+    return p::make_tuple(graph_to_np_int(result), report_dict);
+}
+
+// Row-major codes of an n x p int32 or int64 array
+std::vector<std::int64_t> np_to_codes(const np::ndarray& array) {
+    auto dtype = array.get_dtype();
+    bool is_int64 = dtype == np::dtype::get_builtin<std::int64_t>();
+    if (!is_int64 && dtype != np::dtype::get_builtin<std::int32_t>()) {
+        PyErr_SetString(PyExc_TypeError, "Incorrect array data type");
+        p::throw_error_already_set();
+    }
+    if (array.get_nd() != 2) {
+        PyErr_SetString(PyExc_TypeError, "dim != 2");
+        p::throw_error_already_set();
+    }
+    int s1 = array.shape(0), s2 = array.shape(1);
+    auto narray = array.reshape(p::make_tuple(s1 * s2));
+    std::vector<std::int64_t> data;
+    if (is_int64) {
+        auto arr_data = reinterpret_cast<std::int64_t*>(narray.get_data());
+        data.assign(arr_data, arr_data + s1 * s2);
+    } else {
+        auto arr_data = reinterpret_cast<std::int32_t*>(narray.get_data());
+        data.assign(arr_data, arr_data + s1 * s2);
+    }
+    return data;
+}
+
+// Run GES on categorical data (array: n x p of int32 or int64 codes)
+np::ndarray run_discrete_ges(const np::ndarray& array) {
+    auto data = np_to_codes(array);
+    int s1 = array.shape(0), s2 = array.shape(1);
+
+    // Run GES
+    utils::Graph A0(s2, s2);
+    utils::Graph result;
+    try {
+        auto score_class = DiscreteBIC(data, s1, s2);
+        std::tie(result, std::ignore) =
+            ges::fit(A0, score_class, {"forward", "backward"}, false, 0);
+    } catch (const char* message) {
+        PyErr_SetString(PyExc_ValueError, message);
+        p::throw_error_already_set();
+    }
+
+    // Convert utils::Graph to np::ndarray
+    auto&& result_np = graph_to_np_int(result);
+    return result_np;
+}
+
+// Run GIES Wrapper (arrays: one n_e x p array per environment)
+np::ndarray run_gies(const p::list& arrays, const p::list& interventions) {
+    int n_envs = (int)p::len(arrays);
+    if (n_envs == 0 || p::len(interventions) != n_envs) {
+        PyErr_SetString(PyExc_ValueError,
+                        "Need one intervention list per environment");
+        p::throw_error_already_set();
+    }
+    std::vector<la::Matrix<double>> datasets;
+    std::vector<std::vector<int>> targets;
+    for (int e = 0; e < n_envs; ++e) {
+        np::ndarray array = p::extract<np::ndarray>(arrays[e]);
+        // Make sure we get doubles
+        if (array.get_dtype() != np::dtype::get_builtin<double>()) {
+            PyErr_SetString(PyExc_TypeError, "Incorrect array data type");
+            p::throw_error_already_set();
+        }
+        if (array.get_nd() != 2) {
+            PyErr_SetString(PyExc_TypeError, "dim != 2");
+            p::throw_error_already_set();
+        }
+        if (e > 0 && array.shape(1) != datasets[0].cols()) {
+            PyErr_SetString(PyExc_ValueError,
+                            "Environments have different numbers of variables");
+            p::throw_error_already_set();
+        }
+        datasets.emplace_back(np_to_matrix_double(array));
+        std::vector<int> env_targets;
+        p::object env = interventions[e];
+        for (int i = 0; i < p::len(env); ++i) {
+            int t = p::extract<int>(env[i]);
+            if (t < 0 || t >= array.shape(1)) {
+                PyErr_SetString(PyExc_ValueError,
+                                "Intervention target out of range");
+                p::throw_error_already_set();
+            }
+            env_targets.emplace_back(t);
+        }
+        targets.emplace_back(std::move(env_targets));
+    }
 
     // Run GES
-    auto n = tensor.size(1);
-    auto A0 = torch::zeros({l_len, l_len}).toType(torch::kLong);
-    auto score_class = GaussClusterL0Pen(tensor, graph);
-    auto&& [result, score] =
-        ges::fit(A0, score_class, {"forward", "backward"}, false, 0);
-
-    // Convert torch::Tensor to np::ndarray
-    auto&& result_np = torch_to_np_int(result);
+    utils::Graph result;
+    try {
+        auto score_class = GaussIntL0Pen::from_data(datasets, targets);
+        utils::Graph A0(score_class.p, score_class.p);
+        std::tie(result, std::ignore) =
+            ges::fit(A0, score_class, {"forward", "backward"}, false, 0);
+    } catch (const char* message) {
+        PyErr_SetString(PyExc_ValueError, message);
+        p::throw_error_already_set();
+    }
+
+    // Convert utils::Graph to np::ndarray
+    auto&& result_np = graph_to_np_int(result);
     return result_np;
 }
 
+// Regularization path (array: n x p); returns [(multiplier, graph, score)]
+p::list run_ges_path(const np::ndarray& array,
+                     const p::list& multipliers,
+                     int n_threads,
+                     const std::string& precision) {
+    // Make sure we get doubles
+    if (array.get_dtype() != np::dtype::get_builtin<double>()) {
+        PyErr_SetString(PyExc_TypeError, "Incorrect array data type");
+        p::throw_error_already_set();
+    }
+    if (array.get_nd() != 2) {
+        PyErr_SetString(PyExc_TypeError, "dim != 2");
+        p::throw_error_already_set();
+    }
+    std::vector<double> values;
+    for (int i = 0; i < p::len(multipliers); ++i)
+        values.emplace_back(p::extract<double>(multipliers[i]));
+
+    auto score_precision = parse_precision(precision);
+    std::vector<ges::PathResult> results;
+    la::Matrix<double> storage;
+    try {
+        auto base = GaussObsL0Pen(np_as_view_double(array, storage), true, 0,
+                                  score_precision);
+        results = ges::fit_path(base, values, n_threads);
+    } catch (const char* message) {
+        PyErr_SetString(PyExc_ValueError, message);
+        p::throw_error_already_set();
+    }
+
+    p::list result_list;
+    for (const auto& result : results)
+        result_list.append(p::make_tuple(
+            result.multiplier, graph_to_np_int(result.A), result.score));
+    return result_list;
+}
+
+// Compares the operators chosen with single precision scores against the
+// double precision fit (array: n x p); returns a dict
+p::dict precision_agreement(const np::ndarray& array) {
+    // Make sure we get doubles
+    if (array.get_dtype() != np::dtype::get_builtin<double>()) {
+        PyErr_SetString(PyExc_TypeError, "Incorrect array data type");
+        p::throw_error_already_set();
+    }
+    if (array.get_nd() != 2) {
+        PyErr_SetString(PyExc_TypeError, "dim != 2");
+        p::throw_error_already_set();
+    }
+    la::Matrix<double> storage;
+    auto X = np_as_view_double(array, storage);
+    auto reference = GaussObsL0Pen(X);
+    auto single = GaussObsL0Pen(X, true, 0, Precision::Single);
+    utils::Graph A0(reference.p, reference.p);
+    ges::StepAgreement agreement;
+    try {
+        agreement = ges::step_agreement(A0, reference, single);
+    } catch (const char* message) {
+        PyErr_SetString(PyExc_ValueError, message);
+        p::throw_error_already_set();
+    }
+    p::dict report_dict;
+    report_dict["steps"] = agreement.steps;
+    report_dict["disagreements"] = agreement.disagreements;
+    report_dict["max_gain_diff"] = agreement.max_gain_diff;
+    return report_dict;
+}
+
+// Replays a local_score trace from run_ges(..., trace_path=...) against a
+// score on the given data; returns a dict of throughput and latencies
+p::dict replay_trace(const np::ndarray& array,
+                     const std::string& trace_path,
+                     const std::string& score,
+                     bool misses_only,
+                     int sketch_rows) {
+    std::unique_ptr<DecomposableScore> score_class;
+    if (score == "discrete") {
+        auto data = np_to_codes(array);
+        score_class = std::make_unique<DiscreteBIC>(
+            data, int(array.shape(0)), int(array.shape(1)));
+    } else {
+        // Make sure we get doubles
+        if (array.get_dtype() != np::dtype::get_builtin<double>()) {
+            PyErr_SetString(PyExc_TypeError, "Incorrect array data type");
+            p::throw_error_already_set();
+        }
+        if (array.get_nd() != 2) {
+            PyErr_SetString(PyExc_TypeError, "dim != 2");
+            p::throw_error_already_set();
+        }
+        auto data = np_to_matrix_double(array);
+        bool sketched = score == "countsketch" || score == "subsample";
+        if (sketched && (sketch_rows < 2 || sketch_rows > data.rows())) {
+            PyErr_SetString(
+                PyExc_ValueError,
+                "sketch_rows must be between 2 and the number of rows");
+            p::throw_error_already_set();
+        }
+        if (score == "gauss") {
+            score_class = std::make_unique<GaussObsL0Pen>(std::move(data));
+        } else if (score == "countsketch") {
+            score_class = std::make_unique<GaussSketchL0Pen>(
+                data.view(), sketch_rows,
+                GaussSketchL0Pen::Method::CountSketch);
+        } else if (score == "subsample") {
+            score_class = std::make_unique<GaussSketchL0Pen>(
+                data.view(), sketch_rows, GaussSketchL0Pen::Method::Subsample);
+        } else {
+            PyErr_SetString(PyExc_ValueError, "Unknown score");
+            p::throw_error_already_set();
+        }
+    }
+
+    std::vector<trace::Query> queries;
+    try {
+        queries = trace::read(trace_path);
+    } catch (const char* message) {
+        PyErr_SetString(PyExc_IOError, message);
+        p::throw_error_already_set();
+    }
+    auto report = trace::replay(*score_class, queries, misses_only);
+    p::dict report_dict;
+    report_dict["queries"] = report.queries;
+    report_dict["seconds"] = report.seconds;
+    report_dict["throughput"] = report.throughput;
+    report_dict["p50_us"] = report.p50_us;
+    report_dict["p90_us"] = report.p90_us;
+    report_dict["p99_us"] = report.p99_us;
+    report_dict["max_us"] = report.max_us;
+    report_dict["recorded_hit_rate"] = report.recorded_hit_rate;
+    report_dict["max_abs_diff"] = report.max_abs_diff;
+    return report_dict;
+}
+
+// Worker process for run_ges(..., workers=[...])
+void run_worker(const std::string& address, int sessions) {
+    try {
+        dist::run_worker(address, sessions);
+    } catch (const char* message) {
+        PyErr_SetString(PyExc_RuntimeError, message);
+        p::throw_error_already_set();
+    }
+}
+
 // Deciding what to expose in the library python can import
 BOOST_PYTHON_MODULE(
     gescpp) {  // Thing in brackets should match output library name
     Py_Initialize();
     np::initialize();
-    p::def("run_ges", run_ges);
-    p::def("run_cluster_ges", run_cluster_ges);
+    p::def("run_ges", run_ges,
+           (p::arg("array"), p::arg("cache_path") = "",
+            p::arg("bounded") = false, p::arg("checkpoint_path") = "",
+            p::arg("checkpoint_every") = 1,
+            p::arg("checkpoint_cache") = false, p::arg("workers") = p::list(),
+            p::arg("max_lag") = 0, p::arg("trace_path") = "",
+            p::arg("precision") = "double", p::arg("tiers") = p::list(),
+            p::arg("forbidden") = p::list(), p::arg("required") = p::list(),
+            p::arg("required_adjacencies") = p::list()));
+    p::def("run_sketched_ges", run_sketched_ges,
+           (p::arg("array"), p::arg("sketch_rows"),
+            p::arg("method") = "countsketch", p::arg("seed") = 0,
+            p::arg("refine") = true));
+    p::def("run_discrete_ges", run_discrete_ges);
+    p::def("run_gies", run_gies, (p::arg("arrays"), p::arg("interventions")));
+    p::def("run_ges_path", run_ges_path,
+           (p::arg("array"), p::arg("multipliers"), p::arg("n_threads") = 0,
+            p::arg("precision") = "double"));
+    p::def("precision_agreement", precision_agreement);
+    p::def("replay_trace", replay_trace,
+           (p::arg("array"), p::arg("trace_path"), p::arg("score") = "gauss",
+            p::arg("misses_only") = false, p::arg("sketch_rows") = 1000));
+    p::def("run_worker", run_worker,
+           (p::arg("address"), p::arg("sessions") = 0));
+    p::def("run_cluster_ges", run_cluster_ges,
+           (p::arg("array"), p::arg("graph"), p::arg("cache_path") = ""));
 }
@@ -6,80 +6,88 @@
 #define GESCPP_GES_H
 #include <algorithm>
 #include <iostream>
-#include <set>
+#include <limits>
 #include <string>
-#include <unordered_map>
 #include <vector>
 #include "DecomposableScore.h"
-#include "torch/torch.h"
+#include "checkpoint.h"
+#include "knowledge.h"
 #include "utils.h"
 
 namespace ges {
 using ull = unsigned long long;
 
-auto insert(int x, int y, const std::set<int>& T, const torch::Tensor& A) {
-    auto new_A = A.clone();
-    std::vector<int> T_vec{T.begin(), T.end()};
-    auto T_torch = torch::tensor(T_vec);
-    new_A[x][y] = 1;
-    new_A.index_put_({T_torch, y}, 1);
-    new_A.index_put_({y, T_torch}, 0);
+auto insert(int x, int y, const utils::NodeSet& T, const utils::Graph& A) {
+    auto new_A = A;
+    new_A(x, y) = 1;
+    for (auto t : T) {
+        new_A(t, y) = 1;
+        new_A(y, t) = 0;
+    }
 
     return new_A;
 }
 
-auto delete_node(int x, int y, const std::set<int>& H, const torch::Tensor& A) {
-    auto new_A = A.clone();
-    new_A[x][y] = 0;
-    new_A[y][x] = 0;
-    auto H_torch = torch::tensor(std::vector<int>{H.begin(), H.end()});
-    new_A.index_put_({H_torch, y}, 0);
-    auto n_x = utils::neighbors(x, A);
-    std::vector<int> h_nx;
-    std::set_intersection(H.begin(), H.end(), n_x.begin(), n_x.end(),
-                          std::back_inserter(h_nx));
-    auto h_nx_torch = torch::tensor(h_nx);
-    new_A.index_put_({h_nx_torch, x}, 0);
+auto delete_node(int x,
+                 int y,
+                 const utils::NodeSet& H,
+                 const utils::Graph& A) {
+    auto new_A = A;
+    new_A(x, y) = 0;
+    new_A(y, x) = 0;
+    for (auto h : H)
+        new_A(h, y) = 0;
+    for (auto h : utils::set_intersection(H, utils::neighbors(x, A)))
+        new_A(h, x) = 0;
 
     return new_A;
 }
 
+// Candidates for T in insert(x, y, T): the neighbors of y not adjacent to
+// x that may become parents of y
+auto insert_candidates(int x,
+                       int y,
+                       const utils::Graph& A,
+                       const Constraints& constraints) {
+    auto T0 = utils::set_difference(utils::neighbors(y, A), utils::adj(x, A));
+    if (constraints.empty()) return T0;
+    utils::NodeSet allowed;
+    for (auto t : T0)
+        if (constraints.allowed(t, y)) allowed.insert(t);
+    return allowed;
+}
+
 auto score_valid_insert_operators(int x,
                                   int y,
-                                  const torch::Tensor& A,
+                                  const utils::Graph& A,
                                   DecomposableScore& cache,
-                                  int debug = 0) {
-    int p = A.size(0);
-    auto s1 = utils::neighbors(y, A), s2 = utils::adj(x, A);
-    std::vector<int> T0;
-    std::unordered_map<int, int> reversed_T0;
-
-    std::set_difference(s1.begin(), s1.end(), s2.begin(), s2.end(),
-                        std::back_inserter(T0));
-    for (int i = 0; i < T0.size(); ++i)
-        reversed_T0[T0[i]] = i;
-
-    ull total_valid = (1 << T0.size());
+                                  int debug = 0,
+                                  const Constraints& constraints = {}) {
+    auto T0 = insert_candidates(x, y, A, constraints);
+    auto T0_size = (int)T0.size();
+
+    ull total_valid = (1ull << T0_size);
     std::vector<bool> removed(total_valid, false);
     std::vector<bool> passed_cond_2(total_valid, false);
 
+    // Independent of T, so computed once per pair
+    auto yxT = utils::na(y, x, A);
+    auto pa_y = utils::pa(y, A);
+    auto paths = utils::semi_directed_paths(y, x, A);
+
     int valid_count = 0, best_x = 0, best_y = 0;
-    std::set<int> best_T;
+    utils::NodeSet best_T;
     double best_score = -1e10;
-    torch::Tensor best_A;
 
     // Traverse all subsets of T0
     for (ull sub = 0; sub < total_valid; ++sub) {
         if (removed[sub]) continue;
         // Check Cond 1
-        std::set<int> T;
-        for (int i = 0; i < T0.size(); ++i)
-            if (((1ull << i) & sub) == (1ull << i)) T.insert(T0[i]);
-
-        auto yxT = utils::na(y, x, A);
-        std::set<int> na_yxT;
-        set_union(yxT.begin(), yxT.end(), T.begin(), T.end(),
-                  std::inserter(na_yxT, na_yxT.end()));
+        utils::NodeSet T;
+        for (int i = 0; i < T0_size; ++i)
+            if (((1ull << i) & sub) == (1ull << i)) T.insert(T0.begin()[i]);
+
+        auto na_yxT = utils::set_union(yxT, T);
         auto cond_1 = utils::is_clique(na_yxT, A);
 
         if (!cond_1) {
@@ -92,10 +100,10 @@ auto score_valid_insert_operators(int x,
             cond_2 = true;
         } else {
             cond_2 = true;
-            for (const auto& path : utils::semi_directed_paths(y, x, A)) {
+            for (const auto& path : paths) {
                 int cnt = 0;
                 for (auto node : path) {
-                    if (na_yxT.find(node) != na_yxT.end()) ++cnt;
+                    if (na_yxT.contains(node)) ++cnt;
                 }
                 if (cnt == 0) {
                     cond_2 = false;
@@ -108,11 +116,7 @@ auto score_valid_insert_operators(int x,
             }
         }
         if (cond_1 and cond_2) {
-            auto new_A = insert(x, y, T, A);
-            std::set<int> aux;
-            auto pa_y = utils::pa(y, A);
-            set_union(na_yxT.begin(), na_yxT.end(), pa_y.begin(), pa_y.end(),
-                      std::inserter(aux, aux.end()));
+            auto aux = utils::set_union(na_yxT, pa_y);
             // Compute the change in score
             auto old_score = cache.local_score(y, aux);
             aux.insert(x);
@@ -123,45 +127,50 @@ auto score_valid_insert_operators(int x,
             valid_count++;
             if (new_score - old_score > best_score) {
                 best_score = new_score - old_score;
-                best_A = new_A;
                 best_x = x, best_y = y;
-                best_T = T;
+                best_T = std::move(T);
             }
         }
     }
 
-    return std::make_tuple(best_score, best_A, valid_count, best_x, best_y,
-                           best_T);
+    return std::make_tuple(best_score, valid_count, best_x, best_y,
+                           std::move(best_T));
 }
 
 auto score_valid_delete_operators(int x,
                                   int y,
-                                  const torch::Tensor& A,
+                                  const utils::Graph& A,
                                   DecomposableScore& cache,
-                                  int debug = 0) {
+                                  int debug = 0,
+                                  const Constraints& constraints = {}) {
     auto na_yx = utils::na(y, x, A);
-    std::vector<int> H0{na_yx.begin(), na_yx.end()};
-
-    ull total_valid = (1 << H0.size());
+    // Only nodes h the operator may orient y -> h, and x -> h where x - h
+    // is undirected, enter H
+    utils::NodeSet H0;
+    for (auto h : na_yx)
+        if (constraints.allowed(y, h) &&
+            (A(x, h) == 0 || A(h, x) == 0 || constraints.allowed(x, h)))
+            H0.insert(h);
+    auto H0_size = (int)H0.size();
+    auto pa_y = utils::pa(y, A);
+
+    ull total_valid = (1ull << H0_size);
     std::vector<bool> cond_1_list(total_valid, false);
 
     int valid_count = 0, best_x = 0, best_y = 0;
     double best_score = -1e10;
-    std::set<int> best_T;
-    torch::Tensor best_A;
+    utils::NodeSet best_T;
 
     // Traverse all subsets of T0
     for (ull sub = 0; sub < total_valid; ++sub) {
         // Check Cond 1
-        std::set<int> H;
-        for (int i = 0; i < H0.size(); ++i)
-            if (((1ull << i) & sub) == (1ull << i)) H.insert(H0[i]);
+        utils::NodeSet H;
+        for (int i = 0; i < H0_size; ++i)
+            if (((1ull << i) & sub) == (1ull << i)) H.insert(H0.begin()[i]);
 
         // Check cond1
         auto cond_1 = cond_1_list[sub];
-        std::set<int> na_yx_h;
-        std::set_difference(na_yx.begin(), na_yx.end(), H.begin(), H.end(),
-                            std::inserter(na_yx_h, na_yx_h.end()));
+        auto na_yx_h = utils::set_difference(na_yx, H);
         if (!cond_1 and utils::is_clique(na_yx_h, A)) {
             cond_1 = true;
             for (ull sup = 0; sup < total_valid; ++sup) {
@@ -171,11 +180,7 @@ auto score_valid_delete_operators(int x,
             }
         }
         if (cond_1) {
-            auto new_A = delete_node(x, y, H, A);
-            auto pa_y = utils::pa(y, A);
-            std::set<int> aux;
-            std::set_union(na_yx_h.begin(), na_yx_h.end(), pa_y.begin(),
-                           pa_y.end(), std::inserter(aux, aux.end()));
+            auto aux = utils::set_union(na_yx_h, pa_y);
             aux.insert(x);
             auto old_score = cache.local_score(y, aux);
             aux.erase(x);
@@ -188,147 +193,256 @@ auto score_valid_delete_operators(int x,
             ++valid_count;
             if (new_score - old_score > best_score) {
                 best_score = new_score - old_score;
-                best_A = new_A;
                 best_x = x, best_y = y;
-                best_T = H;
+                best_T = std::move(H);
             }
         }
     }
 
-    return std::make_tuple(best_score, best_A, valid_count, best_x, best_y,
-                           best_T);
+    return std::make_tuple(best_score, valid_count, best_x, best_y,
+                           std::move(best_T));
 }
 
-auto forward_step(const torch::Tensor& A,
-                  DecomposableScore& cache,
-                  int debug,
-                  const torch::Tensor& fixedgaps) {
-    int n = A.size(0);
+auto insert_gain_bound(int x,
+                       int y,
+                       const utils::Graph& A,
+                       DecomposableScore& cache,
+                       const Constraints& constraints = {}) {
+    auto T0 = insert_candidates(x, y, A, constraints);
+    auto base = utils::set_union(utils::na(y, x, A), utils::pa(y, A));
+    return cache.insert_gain_bound(x, y, base, T0);
+}
+
+// Best operator of a step, or of one shard of the step's operators
+struct StepResult {
+    double score = -1e10;
     int op_cnt = 0;
-    torch::Tensor best_A;
-    int best_x, best_y;
-    std::set<int> best_T;
-    double best_score = -1e10;
+    // Position of the operator's pair in the exhaustive order, -1 if none
+    int k = -1;
+    int x = 0, y = 0;
+    std::vector<int> T;
+
+    // Keeps the better of two results; ties go to the earlier pair
+    void merge(const StepResult& other) {
+        op_cnt += other.op_cnt;
+        if (other.k >= 0 &&
+            (other.score > score || (other.score == score && other.k < k))) {
+            score = other.score;
+            k = other.k;
+            x = other.x, y = other.y;
+            T = other.T;
+        }
+    }
+};
 
+// Scores the insert operators of the pairs k with k % nshards == shard
+auto score_forward(const utils::Graph& A,
+                   DecomposableScore& cache,
+                   int debug,
+                   const Constraints& constraints,
+                   bool bounded = false,
+                   int shard = 0,
+                   int nshards = 1) {
+    // Node sets of this step are allocated from the step arena
+    utils::NodeArena::Scope arena_scope;
+    int n = (int)A.rows();
+    StepResult best;
+
+    // Candidate pairs in the order of the exhaustive search
+    std::vector<std::pair<int, int>> pairs;
     for (int i = 0; i < n; ++i) {
         for (int j = 0; j < n; ++j) {
-            if ((A[i][j] == 1).item().toBool() ||
-                (A[j][i] == 1).item().toBool() || i == j)
-                continue;
-            if (fixedgaps[i][j].item().toInt() == 1) continue;
-            ++op_cnt;
-            if (debug > 1)
-                std::cout << "Testing operator " << i << " to " << j
-                          << std::endl;
-            // Get score
-            auto&& [score, new_A, valid_cnt, new_x, new_y, new_T] =
-                score_valid_insert_operators(i, j, A, cache,
-                                             std::max(0, debug - 1));
-            op_cnt += valid_cnt;
-            if (score > best_score) {
-                best_score = score;
-                best_A = new_A;
-                best_x = new_x, best_y = new_y;
-                best_T = new_T;
-            }
+            if (i == j || !constraints.allowed(i, j)) continue;
+            if (A(i, j) == 1 || A(j, i) == 1) continue;
+            pairs.emplace_back(i, j);
         }
     }
-    if (op_cnt == 0) {
+
+    // In bounded mode pairs are scored by decreasing gain bound, and the
+    // scan stops at the first bound that cannot beat the incumbent. Ties
+    // go to the earlier pair, so the result matches the exhaustive search.
+    std::vector<double> bounds(pairs.size(),
+                               std::numeric_limits<double>::infinity());
+    std::vector<int> order;
+    for (int k = shard; k < pairs.size(); k += nshards)
+        order.emplace_back(k);
+    if (bounded) {
+        for (auto k : order)
+            bounds[k] = insert_gain_bound(pairs[k].first, pairs[k].second, A,
+                                          cache, constraints);
+        std::stable_sort(order.begin(), order.end(), [&](int l, int r) {
+            return bounds[l] > bounds[r];
+        });
+    }
+
+    best.op_cnt = int(order.size());
+    for (int pos = 0; pos < order.size(); ++pos) {
+        auto k = order[pos];
+        auto [i, j] = pairs[k];
+        auto tol = 1e-9 * std::max(1.0, std::abs(best.score));
+        if (bounded && bounds[k] < best.score - tol) {
+            if (debug > 1)
+                std::cout << "Pruned " << order.size() - pos
+                          << " operators by bound" << std::endl;
+            break;
+        }
         if (debug > 1)
-            std::cout << "No valid insert operators remain" << std::endl;
-        return std::make_tuple(0.0, A);
-    } else {
-        if (debug) {
-            std::cout << "Best operator: insert(" << best_x << ", " << best_y
-                      << ", [";
-            for (auto p : best_T) {
-                std::cout << p << ",";
-            }
-            std::cout << "]) -> " << best_score << std::endl;
+            std::cout << "Testing operator " << i << " to " << j << std::endl;
+        // Get score
+        auto&& [score, valid_cnt, new_x, new_y, new_T] =
+            score_valid_insert_operators(i, j, A, cache,
+                                         std::max(0, debug - 1), constraints);
+        best.op_cnt += valid_cnt;
+        if (score > best.score || (score == best.score && k < best.k)) {
+            best.score = score;
+            best.x = new_x, best.y = new_y;
+            best.T.assign(new_T.begin(), new_T.end());
+            best.k = k;
         }
-        return std::make_tuple(best_score, best_A);
     }
+    return best;
 }
 
-auto backward_step(const torch::Tensor& A,
-                   DecomposableScore& cache,
-                   int debug = 0) {
-    // Get candidate edges
-    auto directed_fro_to = torch::where(utils::only_directed(A));
-    auto fro = utils::tensor_to_int_vector(directed_fro_to[0]);
-    auto to = utils::tensor_to_int_vector(directed_fro_to[1]);
-    auto undirected_fro_to = torch::where(utils::only_undirected(A));
-    auto un_fro = utils::tensor_to_int_vector(undirected_fro_to[0]);
-    auto un_to = utils::tensor_to_int_vector(undirected_fro_to[1]);
-    for (int i = 0; i < un_fro.size(); ++i) {
-        if (un_fro[i] > un_to[i]) {
-            fro.emplace_back(un_fro[i]);
-            to.emplace_back(un_to[i]);
-        }
-    }
+// Scores the delete operators of the edges k with k % nshards == shard
+auto score_backward(const utils::Graph& A,
+                    DecomposableScore& cache,
+                    int debug = 0,
+                    const Constraints& constraints = {},
+                    int shard = 0,
+                    int nshards = 1) {
+    // Node sets of this step are allocated from the step arena
+    utils::NodeArena::Scope arena_scope;
+    // Get candidate edges: directed ones, then undirected ones once.
+    // Required adjacencies are never deleted.
+    int n = (int)A.rows();
+    std::vector<int> fro, to;
+    for (int i = 0; i < n; ++i)
+        for (int j = 0; j < n; ++j)
+            if (A(i, j) != 0 && A(j, i) == 0 && !constraints.required(i, j)) {
+                fro.emplace_back(i);
+                to.emplace_back(j);
+            }
+    for (int i = 0; i < n; ++i)
+        for (int j = 0; j < i; ++j)
+            if (A(i, j) != 0 && A(j, i) != 0 && !constraints.required(i, j)) {
+                fro.emplace_back(i);
+                to.emplace_back(j);
+            }
 
     // score
-    int op_cnt = 0;
-    torch::Tensor best_A;
-    double best_score = -1e10;
-    int best_x, best_y;
-    std::set<int> best_T;
-
-    for (int i = 0; i < fro.size(); ++i) {
+    StepResult best;
+    for (int i = shard; i < fro.size(); i += nshards) {
         if (debug > 1) {
             std::cout << "Testing remove " << fro[i] << " to " << to[i]
                       << std::endl;
         }
         // Get score
-        auto&& [score, new_A, valid_cnt, new_x, new_y, new_T] =
+        auto&& [score, valid_cnt, new_x, new_y, new_T] =
             score_valid_delete_operators(fro[i], to[i], A, cache,
-                                         std::max(debug - 1, 0));
-        op_cnt += valid_cnt;
-        if (score > best_score) {
-            best_A = new_A;
-            best_score = score;
-            best_x = new_x, best_y = new_y;
-            best_T = new_T;
+                                         std::max(debug - 1, 0), constraints);
+        best.op_cnt += valid_cnt;
+        if (score > best.score) {
+            best.score = score;
+            best.x = new_x, best.y = new_y;
+            best.T.assign(new_T.begin(), new_T.end());
+            best.k = i;
         }
     }
+    return best;
+}
 
-    if (op_cnt == 0) {
+// Scores the operators of a step somewhere other than in this process
+class StepExecutor {
+   public:
+    virtual ~StepExecutor() = default;
+    virtual StepResult forward(const utils::Graph& A,
+                               int debug,
+                               const Constraints& constraints,
+                               bool bounded) = 0;
+    virtual StepResult backward(const utils::Graph& A,
+                                int debug,
+                                const Constraints& constraints) = 0;
+};
+
+auto forward_step(const utils::Graph& A,
+                  DecomposableScore& cache,
+                  int debug,
+                  const Constraints& constraints,
+                  bool bounded = false,
+                  StepExecutor* executor = nullptr) {
+    auto best = executor
+                    ? executor->forward(A, debug, constraints, bounded)
+                    : score_forward(A, cache, debug, constraints, bounded);
+    if (best.op_cnt == 0) {
+        if (debug > 1)
+            std::cout << "No valid insert operators remain" << std::endl;
+        return std::make_tuple(0.0, A);
+    } else {
+        if (debug) {
+            std::cout << "Best operator: insert(" << best.x << ", " << best.y
+                      << ", [";
+            for (auto p : best.T) {
+                std::cout << p << ",";
+            }
+            std::cout << "]) -> " << best.score << std::endl;
+        }
+        // Only the best operator is applied to a copy of the graph
+        utils::Graph best_A;
+        if (best.k >= 0)
+            best_A = insert(best.x, best.y,
+                            utils::NodeSet(best.T.begin(), best.T.end()), A);
+        return std::make_tuple(best.score, best_A);
+    }
+}
+
+auto backward_step(const utils::Graph& A,
+                   DecomposableScore& cache,
+                   int debug = 0,
+                   const Constraints& constraints = {},
+                   StepExecutor* executor = nullptr) {
+    auto best = executor ? executor->backward(A, debug, constraints)
+                         : score_backward(A, cache, debug, constraints);
+    if (best.op_cnt == 0) {
         if (debug > 1) {
             std::cout << "No valid delete operators remain" << std::endl;
         }
         return std::make_tuple(0.0, A);
     } else {
         if (debug) {
-            std::cout << "Best operator: delete(" << best_x << ", " << best_y
+            std::cout << "Best operator: delete(" << best.x << ", " << best.y
                       << ", [";
-            for (auto p : best_T) {
+            for (auto p : best.T) {
                 std::cout << p << ",";
             }
-            std::cout << "]) -> " << best_score << std::endl;
+            std::cout << "]) -> " << best.score << std::endl;
         }
-        return std::make_tuple(best_score, best_A);
+        utils::Graph best_A;
+        if (best.k >= 0)
+            best_A = delete_node(best.x, best.y,
+                                 utils::NodeSet(best.T.begin(), best.T.end()),
+                                 A);
+        return std::make_tuple(best.score, best_A);
     }
 }
 
-auto fit(const torch::Tensor& A0,
-         DecomposableScore& score_class,
-         const std::vector<std::string>& phases = {"forward", "backward"},
-         bool iterate = false,
-         int debug = 0,
-         const torch::Tensor& fixedgaps = at::empty({})) {
-    torch::Tensor new_fixedgaps;
-    if (fixedgaps.sizes().size() < 2) {
-        new_fixedgaps = torch::zeros_like(A0);
-    } else
-        new_fixedgaps = fixedgaps;
-
+// Runs the phases from a given state; fit() and resume() start here
+auto fit_from(FitState state,
+              DecomposableScore& score_class,
+              const std::vector<std::string>& phases = {"forward", "backward"},
+              bool iterate = false,
+              int debug = 0,
+              const Constraints& constraints = {},
+              bool bounded = false,
+              const Checkpoint& checkpoint = {},
+              StepExecutor* executor = nullptr) {
     // GES procedure
-    double total_score = 0;
-    auto A = A0.clone();
+    Checkpointer checkpointer(checkpoint, score_class);
+    auto& A = state.A;
+    auto& total_score = state.total_score;
 
     while (true) {
-        auto last_total_score = total_score;
-        for (const auto& phase : phases) {
+        for (; state.phase < phases.size(); ++state.phase) {
+            const auto& phase = phases[state.phase];
             if (phase == "forward") {
                 if (debug) {
                     std::cout
@@ -337,11 +451,13 @@ auto fit(const torch::Tensor& A0,
                 }
                 while (true) {
                     auto [score_change, new_A] =
-                        forward_step(A, score_class, debug, new_fixedgaps);
+                        forward_step(A, score_class, debug, constraints,
+                                     bounded, executor);
                     if (score_change > 0.0) {
-                        A = utils::pdag_to_cpdag(new_A);
+                        A = constraints.orient(utils::pdag_to_cpdag(new_A));
                         // A = new_A.clone();
                         total_score += score_change;
+                        checkpointer.accepted(state);
                     } else
                         break;
                 }
@@ -353,11 +469,13 @@ auto fit(const torch::Tensor& A0,
                 }
                 while (true) {
                     auto [score_change, new_A] =
-                        backward_step(A, score_class, debug);
+                        backward_step(A, score_class, debug, constraints,
+                                      executor);
                     if (score_change > 0.0) {
-                        A = utils::pdag_to_cpdag(new_A);
+                        A = constraints.orient(utils::pdag_to_cpdag(new_A));
                         // A = new_A.clone();
                         total_score += score_change;
+                        checkpointer.accepted(state);
                     } else
                         break;
                 }
@@ -365,13 +483,106 @@ auto fit(const torch::Tensor& A0,
                 throw "No such phase";
             }
         }
-        if (total_score <= last_total_score or !iterate) {
+        state.phase = 0;
+        ++state.iteration;
+        if (total_score <= state.last_total_score or !iterate) {
             break;
         }
+        state.last_total_score = total_score;
     }
+    if (!checkpointer.wait()) throw "Checkpoint write failed";
 
     return std::make_tuple(A, total_score);
 }
+
+// Fits from A0, to which the required adjacencies of the constraints are
+// added first
+auto fit(const utils::Graph& A0,
+         DecomposableScore& score_class,
+         const std::vector<std::string>& phases = {"forward", "backward"},
+         bool iterate = false,
+         int debug = 0,
+         const Constraints& constraints = {},
+         bool bounded = false,
+         const Checkpoint& checkpoint = {},
+         StepExecutor* executor = nullptr) {
+    FitState state;
+    state.A = constraints.with_required(A0);
+    return fit_from(std::move(state), score_class, phases, iterate, debug,
+                    constraints, bounded, checkpoint, executor);
+}
+
+// Continues a fit from its latest checkpoint with the same arguments the
+// fit was started with; the result equals that of an uninterrupted run
+auto resume(DecomposableScore& score_class,
+            const std::vector<std::string>& phases = {"forward", "backward"},
+            bool iterate = false,
+            int debug = 0,
+            const Constraints& constraints = {},
+            bool bounded = false,
+            const Checkpoint& checkpoint = {},
+            StepExecutor* executor = nullptr) {
+    FitState state;
+    if (!read_checkpoint(checkpoint.path, score_class.fingerprint(), state)) {
+        throw "Cannot read checkpoint";
+    }
+    if (checkpoint.with_cache)
+        score_class.load_cache(checkpoint_cache_path(checkpoint.path));
+    return fit_from(std::move(state), score_class, phases, iterate, debug,
+                    constraints, bounded, checkpoint, executor);
+}
+
+// How often a second score picks a different operator than a reference
+struct StepAgreement {
+    int steps = 0;
+    int disagreements = 0;
+    double max_gain_diff = 0;
+};
+
+// Follows the fit of the reference score and, at every step, compares the
+// best operator under both scores. A step disagrees if only one of the two
+// would be accepted or if they lead to different CPDAGs; operators that tie
+// and lead to the same equivalence class agree.
+auto step_agreement(const utils::Graph& A0,
+                    DecomposableScore& reference,
+                    DecomposableScore& other,
+                    const std::vector<std::string>& phases = {"forward",
+                                                              "backward"}) {
+    StepAgreement agreement;
+    auto A = A0;
+    for (const auto& phase : phases) {
+        if (phase != "forward" && phase != "backward") throw "No such phase";
+        bool forward = phase == "forward";
+        while (true) {
+            auto best = forward ? score_forward(A, reference, 0, {})
+                                : score_backward(A, reference);
+            auto alt = forward ? score_forward(A, other, 0, {})
+                               : score_backward(A, other);
+            bool accepted = best.op_cnt > 0 && best.k >= 0 && best.score > 0;
+            bool alt_accepted = alt.op_cnt > 0 && alt.k >= 0 && alt.score > 0;
+            if (!accepted && !alt_accepted) break;
+            auto apply = [&](const StepResult& step) {
+                utils::NodeSet T(step.T.begin(), step.T.end());
+                return utils::pdag_to_cpdag(
+                    forward ? insert(step.x, step.y, T, A)
+                            : delete_node(step.x, step.y, T, A));
+            };
+            ++agreement.steps;
+            agreement.max_gain_diff = std::max(
+                agreement.max_gain_diff, std::abs(best.score - alt.score));
+            if (accepted != alt_accepted) {
+                ++agreement.disagreements;
+                if (!accepted) break;
+                A = apply(best);
+                continue;
+            }
+            auto next = apply(best);
+            if (!(next == apply(alt))) ++agreement.disagreements;
+            A = std::move(next);
+        }
+    }
+    return agreement;
+}
 }  // namespace ges
 
 #endif  // GESCPP_GES_H
@@ -0,0 +1,196 @@
+#ifndef GESCPP_KNOWLEDGE_H
+#define GESCPP_KNOWLEDGE_H
+#include <cstdint>
+#include <utility>
+#include <vector>
+#include "utils.h"
+
+namespace ges {
+// Background knowledge on the graph, as given by the user. Nodes in no tier
+// are unconstrained by the tiers.
+struct Knowledge {
+    // Groups of nodes in causal order: no edge points into an earlier tier
+    std::vector<std::vector<int>> tiers;
+    // Directed edges x -> y that must not, or must, be in the graph
+    std::vector<std::pair<int, int>> forbidden, required;
+    // Pairs that must be adjacent, in either direction
+    std::vector<std::pair<int, int>> required_adjacencies;
+    // Pairs (i, j) with gaps(i, j) == 1 are never adjacent; p x p or empty
+    utils::Graph gaps;
+};
+
+// Knowledge compiled for the search into two bitsets per node: the nodes
+// allowed as its parents and the nodes that must stay adjacent to it. The
+// default constraints allow everything.
+class Constraints {
+   public:
+    int p = 0;
+    // Bit x of row y, rows of words() words: x may be a parent of y, and
+    // x must stay adjacent to y
+    std::vector<std::uint64_t> parents, adjacent;
+
+    Constraints() = default;
+    Constraints(int p, const Knowledge& knowledge) : p(p) {
+        auto w = words();
+        parents.assign(std::size_t(p) * w, 0);
+        adjacent.assign(std::size_t(p) * w, 0);
+        for (int y = 0; y < p; ++y)
+            for (int x = 0; x < p; ++x)
+                if (x != y) set(parents, x, y, true);
+
+        auto check = [&](int x, int y) {
+            if (x < 0 || y < 0 || x >= p || y >= p) throw "Node out of range";
+            if (x == y) throw "Edge from a node to itself";
+        };
+        std::vector<int> tier(p, -1);
+        for (int t = 0; t < knowledge.tiers.size(); ++t)
+            for (auto x : knowledge.tiers[t]) {
+                if (x < 0 || x >= p) throw "Node out of range";
+                tier[x] = t;
+            }
+        for (int x = 0; x < p; ++x)
+            for (int y = 0; y < p; ++y)
+                if (tier[x] >= 0 && tier[y] >= 0 && tier[x] > tier[y])
+                    set(parents, x, y, false);
+        if (!knowledge.gaps.empty()) {
+            if (knowledge.gaps.rows() != p || knowledge.gaps.cols() != p)
+                throw "Gaps must be p x p";
+            for (int x = 0; x < p; ++x)
+                for (int y = 0; y < p; ++y)
+                    if (knowledge.gaps(x, y) == 1 || knowledge.gaps(y, x) == 1)
+                        set(parents, x, y, false);
+        }
+        for (auto [x, y] : knowledge.forbidden) {
+            check(x, y);
+            set(parents, x, y, false);
+        }
+        for (auto [x, y] : knowledge.required) {
+            check(x, y);
+            if (!allowed(x, y)) throw "Inconsistent background knowledge";
+            set(parents, y, x, false);
+            set(adjacent, x, y, true);
+            set(adjacent, y, x, true);
+        }
+        for (auto [x, y] : knowledge.required_adjacencies) {
+            check(x, y);
+            if (!allowed(x, y) && !allowed(y, x))
+                throw "Inconsistent background knowledge";
+            set(adjacent, x, y, true);
+            set(adjacent, y, x, true);
+        }
+    }
+
+    [[nodiscard]] int words() const { return (p + 63) / 64; }
+    [[nodiscard]] bool empty() const { return p == 0; }
+
+    // Whether the search may orient an edge x -> y
+    [[nodiscard]] bool allowed(int x, int y) const {
+        return empty() || get(parents, x, y);
+    }
+    // Whether x and y must stay adjacent
+    [[nodiscard]] bool required(int x, int y) const {
+        return !empty() && get(adjacent, x, y);
+    }
+
+    // A with the required adjacencies added, directed where only one
+    // direction is allowed, oriented as by orient()
+    [[nodiscard]] utils::Graph with_required(const utils::Graph& A) const {
+        if (empty()) return A;
+        auto new_A = A;
+        bool added = false;
+        for (int x = 0; x < p; ++x)
+            for (int y = 0; y < p; ++y) {
+                if (!required(x, y) || A(x, y) || A(y, x)) continue;
+                new_A(x, y) = allowed(x, y);
+                new_A(y, x) = allowed(y, x);
+                added = true;
+            }
+        if (!added) return A;
+        try {
+            return orient(utils::pdag_to_cpdag(new_A));
+        } catch (const char*) {
+            throw "Required edges do not fit the initial graph";
+        }
+    }
+
+    // Orients the undirected edges of a CPDAG that only one direction is
+    // allowed for, and then the edges this compels by Meek's rules
+    [[nodiscard]] utils::Graph orient(utils::Graph A) const {
+        if (empty()) return A;
+        auto undirected = [&](int a, int b) { return A(a, b) && A(b, a); };
+        auto directed = [&](int a, int b) { return A(a, b) && !A(b, a); };
+        auto adjacent = [&](int a, int b) { return A(a, b) || A(b, a); };
+        // Orienting never changes the adjacencies, so the rules only need
+        // to look at the neighbours of an edge
+        std::vector<std::vector<int>> neighbours(p);
+        for (int a = 0; a < p; ++a)
+            for (int b = 0; b < p; ++b)
+                if (adjacent(a, b)) neighbours[a].emplace_back(b);
+
+        // Whether a - b is compelled to a -> b
+        auto compelled = [&](int a, int b) {
+            for (auto c : neighbours[a]) {
+                if (c == b) continue;
+                // R1: c -> a - b, c and b not adjacent
+                if (directed(c, a) && !adjacent(c, b)) return true;
+                // R2: a -> c -> b
+                if (directed(a, c) && directed(c, b)) return true;
+                if (!undirected(a, c)) continue;
+                for (auto d : neighbours[a]) {
+                    if (d == b || d == c) continue;
+                    // R3: a - c -> b, a - d -> b, c and d not adjacent
+                    if (undirected(a, d) && directed(c, b) &&
+                        directed(d, b) && !adjacent(c, d))
+                        return true;
+                    // R4: a - c -> d -> b, a and d adjacent, c and b not
+                    if (directed(c, d) && directed(d, b) && !adjacent(c, b))
+                        return true;
+                }
+            }
+            return false;
+        };
+
+        // Edges to check; orienting a -> b can only compel edges that touch
+        // a neighbour of a or b
+        std::vector<std::pair<int, int>> work;
+        auto push_edges_at = [&](int x) {
+            for (auto y : neighbours[x])
+                if (undirected(x, y)) {
+                    work.emplace_back(x, y);
+                    work.emplace_back(y, x);
+                }
+        };
+        auto orient_edge = [&](int a, int b) {
+            A(b, a) = 0;
+            for (auto x : {a, b})
+                for (auto y : neighbours[x])
+                    push_edges_at(y);
+        };
+        for (int a = 0; a < p; ++a)
+            for (auto b : neighbours[a])
+                if (undirected(a, b) && !allowed(b, a)) orient_edge(a, b);
+        for (int a = 0; a < p; ++a)
+            push_edges_at(a);
+        while (!work.empty()) {
+            auto [a, b] = work.back();
+            work.pop_back();
+            if (undirected(a, b) && compelled(a, b)) orient_edge(a, b);
+        }
+        return A;
+    }
+
+   private:
+    [[nodiscard]] bool get(const std::vector<std::uint64_t>& bits,
+                           int x,
+                           int y) const {
+        return (bits[std::size_t(y) * words() + x / 64] >> (x % 64)) & 1;
+    }
+    void set(std::vector<std::uint64_t>& bits, int x, int y, bool value) {
+        auto& word = bits[std::size_t(y) * words() + x / 64];
+        auto mask = std::uint64_t(1) << (x % 64);
+        word = value ? word | mask : word & ~mask;
+    }
+};
+}  // namespace ges
+
+#endif  // GESCPP_KNOWLEDGE_H
@@ -0,0 +1,190 @@
+#ifndef GESCPP_PATH_H
+#define GESCPP_PATH_H
+#include <algorithm>
+#include <condition_variable>
+#include <cstdint>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <numeric>
+#include <string>
+#include <thread>
+#include <vector>
+#include "DecomposableScore.h"
+#include "ges.h"
+#include "knowledge.h"
+#include "utils.h"
+
+namespace ges {
+// One point of a regularization path
+struct PathResult {
+    double multiplier;
+    utils::Graph A;
+    double score;
+};
+
+// Scores the operators of every step in threads, one shard and one copy of
+// the score per thread. The copies share the data and the likelihoods, and
+// the reduced result equals that of a single thread. The calling thread
+// scores shard 0; the other threads live as long as the executor, so their
+// thread-local node arenas are reused from step to step.
+class ThreadExecutor : public StepExecutor {
+   public:
+    ThreadExecutor(const GaussObsL0Pen& score, int n_threads)
+        : scores(n_threads, score) {
+        for (int t = 1; t < n_threads; ++t)
+            workers.emplace_back([this, t] { work(t); });
+    }
+    ThreadExecutor(const ThreadExecutor&) = delete;
+    ThreadExecutor& operator=(const ThreadExecutor&) = delete;
+    ~ThreadExecutor() override {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        start.notify_all();
+        for (auto& worker : workers)
+            worker.join();
+    }
+
+    StepResult forward(const utils::Graph& A,
+                       int debug,
+                       const Constraints& constraints,
+                       bool bounded) override {
+        return run([&](int t) {
+            return score_forward(A, scores[t], debug, constraints, bounded, t,
+                                 int(scores.size()));
+        });
+    }
+
+    StepResult backward(const utils::Graph& A,
+                        int debug,
+                        const Constraints& constraints) override {
+        return run([&](int t) {
+            return score_backward(A, scores[t], debug, constraints, t,
+                                  int(scores.size()));
+        });
+    }
+
+    std::vector<GaussObsL0Pen> scores;
+
+   private:
+    template <typename F>
+    StepResult run(F&& score_shard) {
+        int n_threads = int(scores.size());
+        std::vector<StepResult> results(n_threads);
+        std::vector<std::exception_ptr> errors(n_threads);
+        auto shard = [&](int t) {
+            try {
+                results[t] = score_shard(t);
+            } catch (...) {
+                errors[t] = std::current_exception();
+            }
+        };
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            job = shard;
+            running = n_threads - 1;
+            ++generation;
+        }
+        start.notify_all();
+        shard(0);
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            done.wait(lock, [&] { return running == 0; });
+            job = nullptr;
+        }
+        for (auto& error : errors)
+            if (error) std::rethrow_exception(error);
+        StepResult best;
+        for (const auto& result : results)
+            best.merge(result);
+        return best;
+    }
+
+    // Runs shard t of every job until the executor is destroyed
+    void work(int t) {
+        std::uint64_t seen = 0;
+        while (true) {
+            std::function<void(int)> shard;
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                start.wait(lock,
+                           [&] { return stopping || generation != seen; });
+                if (stopping) return;
+                seen = generation;
+                shard = job;
+            }
+            shard(t);
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                if (--running > 0) continue;
+            }
+            done.notify_one();
+        }
+    }
+
+    std::vector<std::thread> workers;
+    std::mutex mutex;
+    std::condition_variable start, done;
+    // The current job and the workers that have not finished it yet
+    std::function<void(int)> job;
+    int running = 0;
+    std::uint64_t generation = 0;
+    bool stopping = false;
+};
+
+// Fits GES for every penalty lmbda = multiplier * base.lmbda, from the
+// largest penalty down. Every fit warm-starts from the CPDAG of the previous,
+// sparser one, so the fits run one after another; the operators of each
+// step are scored in n_threads threads instead, which does not change the
+// results. All fits share one cache of penalty-free likelihoods. Scores are
+// full DAG scores, so they are comparable across warm starts.
+auto fit_path(const GaussObsL0Pen& base,
+              const std::vector<double>& multipliers,
+              int n_threads = 0,
+              const std::vector<std::string>& phases = {"forward",
+                                                        "backward"},
+              bool iterate = false,
+              int debug = 0,
+              const Constraints& constraints = {}) {
+    int m = (int)multipliers.size();
+    std::vector<int> order(m);
+    std::iota(order.begin(), order.end(), 0);
+    std::stable_sort(order.begin(), order.end(), [&](int l, int r) {
+        return multipliers[l] > multipliers[r];
+    });
+    if (n_threads <= 0) n_threads = (int)std::thread::hardware_concurrency();
+    n_threads = std::max(1, n_threads);
+
+    // Copies of the score share its data
+    GaussObsL0Pen score(base);
+    score.clear_cache();
+    score.likelihoods = std::make_shared<LikelihoodCache>();
+    ThreadExecutor executor(score, n_threads);
+    std::vector<PathResult> results(m);
+    utils::Graph A(base.p, base.p);
+    for (auto k : order) {
+        // Cached local scores include the penalty of the previous fit
+        score.clear_cache();
+        score.lmbda = multipliers[k] * base.lmbda;
+        for (auto& copy : executor.scores) {
+            copy.clear_cache();
+            copy.lmbda = score.lmbda;
+        }
+        auto [cpdag, total] =
+            fit(A, score, phases, iterate, std::max(0, debug - 1),
+                constraints, false, {}, n_threads > 1 ? &executor : nullptr);
+        A = cpdag;
+        results[k] = {multipliers[k], cpdag,
+                      score.full_score(utils::pdag_to_dag(cpdag))};
+        if (debug)
+            std::cout << "Penalty multiplier " << multipliers[k] << " -> "
+                      << results[k].score << std::endl;
+    }
+    return results;
+}
+}  // namespace ges
+
+#endif  // GESCPP_PATH_H
@@ -0,0 +1,30 @@
+#ifndef GESCPP_TORCH_ADAPTER_H
+#define GESCPP_TORCH_ADAPTER_H
+#include "Matrix.h"
+#include "torch/torch.h"
+
+// Conversions between torch tensors and the matrices the library works on,
+// for C++ callers that hold their data and graphs as tensors. Only built
+// with GESCPP_WITH_TORCH.
+namespace la {
+// Copy of a 2-d tensor, converted to T
+template <typename T>
+Matrix<T> from_tensor(const torch::Tensor& tensor) {
+    if (tensor.dim() != 2) throw "Expected a 2-d tensor";
+    auto t = tensor.to(torch::kCPU)
+                 .toType(c10::CppTypeToScalarType<T>::value)
+                 .contiguous();
+    return Matrix<T>::from_data(t.template data_ptr<T>(), t.size(0),
+                                t.size(1));
+}
+
+template <typename T>
+torch::Tensor to_tensor(const Matrix<T>& matrix) {
+    return torch::from_blob(const_cast<T*>(matrix.data()),
+                            {matrix.rows(), matrix.cols()},
+                            c10::CppTypeToScalarType<T>::value)
+        .clone();
+}
+}  // namespace la
+
+#endif  // GESCPP_TORCH_ADAPTER_H
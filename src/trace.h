@@ -0,0 +1,187 @@
+#ifndef GESCPP_TRACE_H
+#define GESCPP_TRACE_H
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <mutex>
+#include <string>
+#include <vector>
+#include "NodeSet.h"
+
+namespace trace {
+// Trace file layout: header, then one record per local_score query. A record
+// is a RecordHeader followed by pa_len int32 parents.
+struct FileHeader {
+    char magic[8];
+    std::uint32_t version;
+    std::uint32_t reserved;
+    std::uint64_t fingerprint;
+};
+struct RecordHeader {
+    std::int32_t x;
+    std::uint16_t pa_len;
+    std::uint8_t hit;
+    std::uint8_t reserved;
+    std::uint32_t nanos;
+    std::uint32_t padding;
+    double value;
+};
+constexpr char magic[8] = {'G', 'E', 'S', 'T', 'R', 'A', 'C', 'E'};
+constexpr std::uint32_t version = 1;
+
+struct Query {
+    int x;
+    std::vector<int> pa;
+    bool hit;
+    std::uint32_t nanos;
+    double value;
+};
+
+// Appends local_score queries to a trace file. Records are buffered and
+// written in large chunks; record() may be called from several threads.
+class Recorder {
+   public:
+    Recorder(const std::string& path, std::uint64_t fingerprint)
+        : out(path, std::ios::binary | std::ios::trunc) {
+        if (!out) throw "Cannot open trace file";
+        FileHeader header{};
+        std::memcpy(header.magic, magic, sizeof(magic));
+        header.version = version;
+        header.fingerprint = fingerprint;
+        out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    }
+    Recorder(const Recorder&) = delete;
+    Recorder& operator=(const Recorder&) = delete;
+    ~Recorder() { flush(); }
+
+    void record(int x,
+                const utils::NodeSet& pa,
+                bool hit,
+                std::chrono::nanoseconds elapsed,
+                double value) {
+        RecordHeader header{};
+        header.x = x;
+        header.pa_len = std::uint16_t(pa.size());
+        header.hit = hit;
+        header.nanos = std::uint32_t(
+            std::min<std::int64_t>(elapsed.count(), UINT32_MAX));
+        header.value = value;
+        std::lock_guard lock(mutex);
+        auto pos = buffer.size();
+        buffer.resize(pos + sizeof(header) + pa.size() * sizeof(std::int32_t));
+        std::memcpy(buffer.data() + pos, &header, sizeof(header));
+        pos += sizeof(header);
+        for (auto v : pa) {
+            auto node = std::int32_t(v);
+            std::memcpy(buffer.data() + pos, &node, sizeof(node));
+            pos += sizeof(node);
+        }
+        if (buffer.size() >= buffer_size) write_buffer();
+    }
+
+    void flush() {
+        std::lock_guard lock(mutex);
+        write_buffer();
+        out.flush();
+    }
+
+   private:
+    static constexpr std::size_t buffer_size = 1 << 20;
+    std::ofstream out;
+    std::vector<char> buffer;
+    std::mutex mutex;
+
+    void write_buffer() {
+        out.write(buffer.data(), std::streamsize(buffer.size()));
+        buffer.clear();
+    }
+};
+
+// Reads all queries of a trace file
+inline std::vector<Query> read(const std::string& path,
+                               std::uint64_t* fingerprint = nullptr) {
+    std::ifstream in(path, std::ios::binary);
+    if (!in) throw "Cannot open trace file";
+    FileHeader header{};
+    in.read(reinterpret_cast<char*>(&header), sizeof(header));
+    if (!in || std::memcmp(header.magic, magic, sizeof(magic)) ||
+        header.version != version)
+        throw "Malformed trace file";
+    if (fingerprint) *fingerprint = header.fingerprint;
+
+    std::vector<Query> queries;
+    RecordHeader record{};
+    while (in.read(reinterpret_cast<char*>(&record), sizeof(record))) {
+        std::vector<std::int32_t> pa(record.pa_len);
+        in.read(reinterpret_cast<char*>(pa.data()),
+                std::streamsize(pa.size() * sizeof(std::int32_t)));
+        if (!in) throw "Truncated trace file";
+        queries.push_back({record.x, {pa.begin(), pa.end()}, record.hit != 0,
+                           record.nanos, record.value});
+    }
+    return queries;
+}
+
+struct ReplayReport {
+    std::size_t queries = 0;
+    double seconds = 0;
+    double throughput = 0;  // queries per second
+    double p50_us = 0, p90_us = 0, p99_us = 0, max_us = 0;
+    double recorded_hit_rate = 0;
+    double max_abs_diff = 0;  // against the recorded values
+};
+
+// Runs the queries of a trace against a score. By default every query goes
+// through local_score, cache included, as in the recorded search. With
+// misses_only, only the queries that missed the cache when recorded are
+// computed, without the cache, which isolates the score backend.
+template <typename Score>
+ReplayReport replay(Score& score,
+                    const std::vector<Query>& queries,
+                    bool misses_only = false) {
+    using clock = std::chrono::steady_clock;
+    ReplayReport report;
+    std::vector<double> latencies;
+    latencies.reserve(queries.size());
+    std::size_t hits = 0;
+    auto start = clock::now();
+    for (const auto& query : queries) {
+        hits += query.hit;
+        if (misses_only && query.hit) continue;
+        utils::NodeSet pa(query.pa.begin(), query.pa.end());
+        auto query_start = clock::now();
+        auto value = misses_only ? score._compute_local_score(query.x, pa)
+                                 : score.local_score(query.x, pa);
+        std::chrono::duration<double, std::micro> elapsed =
+            clock::now() - query_start;
+        latencies.push_back(elapsed.count());
+        report.max_abs_diff =
+            std::max(report.max_abs_diff, std::abs(value - query.value));
+    }
+    report.seconds =
+        std::chrono::duration<double>(clock::now() - start).count();
+    report.queries = latencies.size();
+    if (report.seconds > 0)
+        report.throughput = double(report.queries) / report.seconds;
+    if (!queries.empty())
+        report.recorded_hit_rate = double(hits) / double(queries.size());
+
+    auto percentile = [&](double q) {
+        if (latencies.empty()) return 0.0;
+        auto k = std::size_t(q * double(latencies.size() - 1));
+        std::nth_element(latencies.begin(), latencies.begin() + k,
+                         latencies.end());
+        return latencies[k];
+    };
+    report.p50_us = percentile(0.5);
+    report.p90_us = percentile(0.9);
+    report.p99_us = percentile(0.99);
+    report.max_us = percentile(1.0);
+    return report;
+}
+}  // namespace trace
+
+#endif  // GESCPP_TRACE_H
@@ -6,113 +6,96 @@
 #define GESCPP_UTILS_H
 #include <algorithm>
 #include <functional>
+#include <iostream>
 #include <set>
 #include <string>
 #include <unordered_map>
 #include <vector>
-#include "torch/torch.h"
-using namespace torch::indexing;
+#include "Matrix.h"
+#include "NodeSet.h"
 
 namespace utils {
+// Adjacency matrix: A(i, j) != 0 for an edge i -> j, both directions for an
+// undirected edge
+using Graph = la::Matrix<int64_t>;
+
 auto print(std::string s) {
     std::cout << s << std::endl;
 }
 
-auto tensor_to_int_vector(const torch::Tensor& A) {
-    auto new_A = A.toType(torch::kInt).contiguous();
-    std::vector<int> result{new_A.data_ptr<int>(),
-                            new_A.data_ptr<int>() + new_A.numel()};
+// Nodes j for which keep(i -> j present, j -> i present) holds
+template <typename F>
+auto select_nodes(int i, const Graph& A, F&& keep) {
+    NodeSet result;
+    int p = (int)A.rows();
+    for (int j = 0; j < p; ++j)
+        if (keep(A(i, j) != 0, A(j, i) != 0)) result.insert(j);
     return result;
 }
 
-auto neighbors(int i, const torch::Tensor& A) {
-    auto re_torch = torch::where(torch::logical_and(
-        A.index({i, "..."}) != 0, A.index({"...", i}) != 0))[0]
-                        .toType(torch::kInt)
-                        .contiguous();
-    std::set<int> result{re_torch.data_ptr<int>(),
-                         re_torch.data_ptr<int>() + re_torch.numel()};
-
-    return result;
+auto neighbors(int i, const Graph& A) {
+    return select_nodes(i, A, [](bool out, bool in) { return out && in; });
 }
 
-auto adj(int i, const torch::Tensor& A) {
-    auto re_torch = torch::where(torch::logical_or(A.index({i, "..."}) != 0,
-                                                   A.index({"...", i}) != 0))[0]
-                        .toType(torch::kInt)
-                        .contiguous();
-    std::set<int> result{re_torch.data_ptr<int>(),
-                         re_torch.data_ptr<int>() + re_torch.numel()};
-
-    return result;
+auto adj(int i, const Graph& A) {
+    return select_nodes(i, A, [](bool out, bool in) { return out || in; });
 }
 
-auto na(int y, int x, const torch::Tensor& A) {
-    auto s1 = neighbors(y, A);
-    auto s2 = adj(x, A);
-    std::set<int> result;
-    std::set_intersection(s1.begin(), s1.end(), s2.begin(), s2.end(),
-                          std::inserter(result, result.end()));
-    return result;
+auto na(int y, int x, const Graph& A) {
+    return set_intersection(neighbors(y, A), adj(x, A));
 }
 
-auto pa(int i, const torch::Tensor& A) {
-    auto re_torch = torch::where(torch::logical_and(
-        A.index({"...", i}) != 0, A.index({i, "..."}) == 0))[0]
-                        .toType(torch::kInt)
-                        .contiguous();
-    std::set<int> result{re_torch.data_ptr<int>(),
-                         re_torch.data_ptr<int>() + re_torch.numel()};
-    return result;
+auto pa(int i, const Graph& A) {
+    return select_nodes(i, A, [](bool out, bool in) { return in && !out; });
 }
 
-auto ch(int i, const torch::Tensor& A) {
-    auto re_torch = torch::where(torch::logical_and(
-        A.index({i, "..."}) != 0, A.index({"...", i}) == 0))[0]
-                        .toType(torch::kInt)
-                        .contiguous();
-    std::set<int> result{re_torch.data_ptr<int>(),
-                         re_torch.data_ptr<int>() + re_torch.numel()};
-    return result;
+auto ch(int i, const Graph& A) {
+    return select_nodes(i, A, [](bool out, bool in) { return out && !in; });
 }
 
-auto skeleton(const torch::Tensor& A) {
-    auto result = ((A + A.t()) != 0).toType(torch::kI64);
+auto skeleton(const Graph& A) {
+    Graph result(A.rows(), A.cols());
+    for (int64_t i = 0; i < A.rows(); ++i)
+        for (int64_t j = 0; j < A.cols(); ++j)
+            result(i, j) = A(i, j) != 0 || A(j, i) != 0;
     return result;
 }
 
-auto is_clique(const std::set<int>& S, const torch::Tensor& A) {
-    std::vector<int> S_vec{S.begin(), S.end()};
-    auto S_torch = torch::tensor(S_vec);
-    auto subgraph = A.index({S_torch, "..."}).index({"...", S_torch});
-    int no_edges = torch::sum(skeleton(subgraph) != 0).item().toInt();
-    int n = S.size();
-    return no_edges == n * (n - 1);
+auto is_clique(const NodeSet& S, const Graph& A) {
+    for (auto s = S.begin(); s != S.end(); ++s)
+        for (auto t = s + 1; t != S.end(); ++t)
+            if (A(*s, *t) == 0 && A(*t, *s) == 0) return false;
+    return true;
 }
 
-auto only_directed(const torch::Tensor& P) {
-    auto mask = torch::logical_and(P != 0, P.t() == 0);
-    auto G = torch::zeros_like(P);
-    G.index_put_({mask}, P.index({mask}));
+// Entries of P kept where keep(P(i, j) != 0, P(j, i) != 0) holds
+template <typename F>
+auto select_edges(const Graph& P, F&& keep) {
+    Graph G(P.rows(), P.cols());
+    for (int64_t i = 0; i < P.rows(); ++i)
+        for (int64_t j = 0; j < P.cols(); ++j)
+            if (keep(P(i, j) != 0, P(j, i) != 0)) G(i, j) = P(i, j);
     return G;
 }
 
-auto only_undirected(const torch::Tensor& P) {
-    auto mask = torch::logical_and(P != 0, P.t() != 0);
-    auto G = torch::zeros_like(P);
-    G.index_put_({mask}, P.index({mask}));
-    return G;
+auto only_directed(const Graph& P) {
+    return select_edges(P, [](bool out, bool in) { return out && !in; });
 }
 
-auto topological_ordering(const torch::Tensor& A) {
-    if (only_undirected(A).sum().item().toInt() > 0) {
-        throw "The given graph is not a DAG";
-    }
-    auto new_A = A.clone();
-    auto sinks_torch =
-        torch::where(new_A.sum({0}) == 0)[0].toType(torch::kInt).contiguous();
-    std::vector<int> sinks{sinks_torch.data_ptr<int>(),
-                           sinks_torch.data_ptr<int>() + sinks_torch.numel()};
+auto only_undirected(const Graph& P) {
+    return select_edges(P, [](bool out, bool in) { return out && in; });
+}
+
+auto topological_ordering(const Graph& A) {
+    int p = (int)A.rows();
+    for (int i = 0; i < p; ++i)
+        for (int j = 0; j < p; ++j)
+            if (A(i, j) != 0 && A(j, i) != 0)
+                throw "The given graph is not a DAG";
+    auto new_A = A;
+    std::vector<int> sinks;
+    for (int j = 0; j < p; ++j)
+        if (pa(j, new_A).empty()) sinks.emplace_back(j);
     std::vector<int> ordering;
 
     while (!sinks.empty()) {
@@ -120,21 +103,19 @@ auto topological_ordering(const torch::Tensor& A) {
         sinks.pop_back();
         ordering.emplace_back(i);
         for (auto j : ch(i, new_A)) {
-            new_A[i][j] = 0;
+            new_A(i, j) = 0;
             if (pa(j, new_A).empty()) {
                 sinks.emplace_back(j);
             }
         }
     }
 
-    if (new_A.sum().item().toInt() > 0) {
-        throw "The given graph is not a DAG";
-    } else {
-        return ordering;
-    }
+    for (int64_t k = 0; k < new_A.size(); ++k)
+        if (new_A.data()[k] != 0) throw "The given graph is not a DAG";
+    return ordering;
 }
 
-auto is_dag(const torch::Tensor& A) {
+auto is_dag(const Graph& A) {
     try {
         topological_ordering(A);
         return true;
@@ -143,16 +124,13 @@ auto is_dag(const torch::Tensor& A) {
     }
 }
 
-auto semi_directed_paths(int fro, int to, const torch::Tensor& A) {
+auto semi_directed_paths(int fro, int to, const Graph& A) {
     // Initialize map
-    std::unordered_map<int, std::vector<int>> mdata;
-    auto n = A.size(0);
-    auto exists_torch = torch::where(A != 0);
-    auto fros = exists_torch[0], tos = exists_torch[1];
-    auto fros_size = fros.size(0);
-    for (int i = 0; i < fros_size; ++i) {
-        mdata[fros[i].item().toInt()].emplace_back(tos[i].item().toInt());
-    }
+    auto n = (int)A.rows();
+    std::vector<std::vector<int>> mdata(n);
+    for (int i = 0; i < n; ++i)
+        for (int j = 0; j < n; ++j)
+            if (A(i, j) != 0) mdata[i].emplace_back(j);
 
     // Dfs
     std::vector<bool> visited(n, false);
@@ -176,73 +154,89 @@ auto semi_directed_paths(int fro, int to, const torch::Tensor& A) {
     return paths;
 }
 
-auto pdag_to_dag(const torch::Tensor& _P) {
-    auto P = _P.clone();
-    auto G = only_directed(P);
-    std::vector<int> indexes(P.size(0));
-    for (int i = 0; i < indexes.size(); ++i)
-        indexes[i] = i;
-
-    while (P.size(0) > 0) {
-        auto found = false;
-        int i = 0;
-        while (!found and i < P.size(0)) {
-            // Check condition 1
-            auto sink = ch(i, P).empty();
-            // Check condition 2
-            auto n_i = neighbors(i, P);
-            auto adj_i = adj(i, P);
-            bool adj_neighbors = true;
-            for (auto y : n_i) {
-                auto adj_yP = adj(y, P);
-                for (auto node : adj_i) {
-                    if (node == y) continue;
-                    if (adj_yP.find(node) == adj_yP.end()) {
-                        adj_neighbors = false;
-                        break;
-                    }
-                }
-                if (!adj_neighbors) break;
+// Consistent extension of a PDAG (Dor & Tarsi, 1992). A node can be removed
+// once it has no children and each of its undirected neighbors is adjacent
+// to all of its other adjacent nodes; its undirected edges then point into
+// it. Removing a node only changes the condition of its adjacent nodes, so
+// only those are rechecked. The smallest removable node goes first.
+auto pdag_to_dag(const Graph& P) {
+    int p = (int)P.rows();
+    Graph adjacent(p, p), G(p, p);
+    std::vector<std::vector<int>> adjacents(p);
+    std::vector<int> n_children(p, 0);
+    for (int i = 0; i < p; ++i)
+        for (int j = 0; j < p; ++j) {
+            if (i == j || (P(i, j) == 0 && P(j, i) == 0)) continue;
+            adjacent(i, j) = 1;
+            adjacents[i].emplace_back(j);
+            if (P(j, i) == 0) {
+                ++n_children[i];
+                G(i, j) = 1;
             }
-            found = sink and adj_neighbors;
-            // Orient all incident undirected edges and remove i
-            if (found) {
-                auto real_i = indexes[i];
-                std::vector<int> real_neighbors;
-                for (auto j : n_i)
-                    real_neighbors.emplace_back(indexes[j]);
-                for (auto j : real_neighbors)
-                    G.index_put_({j, real_i}, 1);
-                std::vector<int> all_but_i;
-                for (int j = 0; j < P.size(0); ++j)
-                    if (i != j) all_but_i.emplace_back(j);
-                auto all_but_i_torch = torch::tensor(all_but_i);
-                P = P.index({all_but_i_torch, "..."})
-                        .index({"...", all_but_i_torch});
-                indexes.erase(
-                    std::find(indexes.begin(), indexes.end(), real_i));
-            } else
-                ++i;
         }
 
-        if (!found) {
+    std::vector<char> removed(p, 0);
+    auto undirected = [&](int i, int j) {
+        return P(i, j) != 0 && P(j, i) != 0;
+    };
+    auto removable = [&](int i) {
+        if (n_children[i] > 0) return false;
+        for (auto y : adjacents[i]) {
+            if (removed[y] || !undirected(i, y)) continue;
+            for (auto z : adjacents[i])
+                if (z != y && !removed[z] && !adjacent(y, z)) return false;
+        }
+        return true;
+    };
+
+    std::set<int> candidates;
+    for (int i = 0; i < p; ++i)
+        if (removable(i)) candidates.insert(i);
+    for (int remaining = p; remaining > 0; --remaining) {
+        // No removable node left: fail without rescanning the graph
+        if (candidates.empty())
             throw "PDAG does not admit consistent extension";
+        auto i = *candidates.begin();
+        candidates.erase(candidates.begin());
+        removed[i] = 1;
+        for (auto j : adjacents[i]) {
+            if (removed[j]) continue;
+            if (undirected(i, j)) {
+                G(j, i) = 1;
+            } else if (P(j, i) != 0) {
+                --n_children[j];
+            }
+            if (removable(j)) {
+                candidates.insert(j);
+            } else {
+                candidates.erase(j);
+            }
         }
     }
 
     return G;
 }
 
-auto order_edges(const torch::Tensor& G) {
+auto order_edges(const Graph& G) {
     auto order = topological_ordering(G);
-    auto ordered = (G != 0).toType(torch::kLong) * -1;
+    int p = (int)G.rows();
+    Graph ordered(p, p);
+    int64_t unlabelled = 0;
+    for (int x = 0; x < p; ++x)
+        for (int y = 0; y < p; ++y)
+            if (G(x, y) != 0) {
+                ordered(x, y) = -1;
+                ++unlabelled;
+            }
     int i = 1;
-    while (torch::any(ordered == -1).item().toBool()) {
-        auto ul = torch::hstack(torch::where(ordered == -1))
-                      .toType(torch::kInt)
-                      .contiguous();
-        std::set<int> with_unlablled{ul.data_ptr<int>(),
-                                     ul.data_ptr<int>() + ul.numel()};
+    while (unlabelled > 0) {
+        std::set<int> with_unlablled;
+        for (int x = 0; x < p; ++x)
+            for (int y = 0; y < p; ++y)
+                if (ordered(x, y) == -1) {
+                    with_unlablled.insert(x);
+                    with_unlablled.insert(y);
+                }
         int y = 0;
         for (auto p = order.rbegin(); p != order.rend(); ++p) {
             if (with_unlablled.find(*p) != with_unlablled.end()) {
@@ -250,94 +244,134 @@ auto order_edges(const torch::Tensor& G) {
                 break;
             }
         }
-        auto ul_y = torch::where(ordered.index({"...", y}) == -1)[0]
-                        .toType(torch::kInt)
-                        .contiguous();
-        std::set<int> unlabelled_parents_y{ul_y.data_ptr<int>(),
-                                           ul_y.data_ptr<int>() + ul_y.numel()};
         int x = 0;
         for (auto p : order) {
-            if (unlabelled_parents_y.find(p) != unlabelled_parents_y.end()) {
+            if (ordered(p, y) == -1) {
                 x = p;
                 break;
             }
         }
-        ordered[x][y] = i;
+        if (ordered(x, y) == -1) --unlabelled;
+        ordered(x, y) = i;
         ++i;
     }
 
     return ordered;
 }
 
-auto label_edges(const torch::Tensor& ordered) {
+auto label_edges(const Graph& ordered) {
     // define labels: 1: compelled, -1: reversible, -2: unknown
     int COM = 1, REV = -1, UNK = -2;
-    auto labelled = (ordered != 0).toType(torch::kLong) * UNK;
-
-    while (torch::any(labelled == UNK).item().toBool()) {
-        auto unknown_edges = (ordered * (labelled == UNK).toType(torch::kLong))
-                                 .toType(torch::kFloat);
-        unknown_edges.index_put_({unknown_edges == 0}, -1e10);
-        auto max_pos = torch::argmax(unknown_edges).item().toInt();
-        int x = max_pos / (int)unknown_edges.size(0),
-            y = max_pos % (int)unknown_edges.size(0);
-        auto Ws_torch = torch::where(labelled.index({"...", x}) == COM)[0]
-                            .toType(torch::kInt)
-                            .contiguous();
-        std::vector<int> Ws{Ws_torch.data_ptr<int>(),
-                            Ws_torch.data_ptr<int>() + Ws_torch.numel()};
+    int p = (int)ordered.rows();
+    Graph labelled(p, p);
+    for (int x = 0; x < p; ++x)
+        for (int y = 0; y < p; ++y)
+            if (ordered(x, y) != 0) labelled(x, y) = UNK;
+
+    while (true) {
+        // Unknown edge with the highest order
+        int x = -1, y = -1;
+        for (int i = 0; i < p; ++i)
+            for (int j = 0; j < p; ++j)
+                if (labelled(i, j) == UNK &&
+                    (x < 0 || ordered(i, j) > ordered(x, y)))
+                    x = i, y = j;
+        if (x < 0) break;
         auto end = false;
 
-        for (auto w : Ws) {
-            if (labelled[w][y].item().toInt() == 0) {
-                auto pa_y = pa(y, labelled);
-                auto pa_y_torch =
-                    torch::tensor(std::vector<int>{pa_y.begin(), pa_y.end()});
-                labelled.index_put_({pa_y_torch, y}, COM);
+        for (int w = 0; w < p; ++w) {
+            if (labelled(w, x) != COM) continue;
+            if (labelled(w, y) == 0) {
+                for (auto j : pa(y, labelled))
+                    labelled(j, y) = COM;
                 end = true;
                 break;
             } else {
-                labelled[w][y] = COM;
+                labelled(w, y) = COM;
             }
         }
 
         if (!end) {
             auto s1 = pa(y, labelled), s2 = pa(x, labelled);
             s2.insert(x);
-            std::vector<int> result;
-            std::set_difference(s1.begin(), s1.end(), s2.begin(), s2.end(),
-                                std::back_inserter(result));
-            auto z_exists = result.size() > 0;
-            auto unknown = torch::where(labelled.index({"...", y}) == UNK)[0];
-            if (z_exists) {
-                labelled.index_put_({unknown, y}, COM);
-            } else {
-                labelled.index_put_({unknown, y}, REV);
-            }
+            auto z_exists = !set_difference(s1, s2).empty();
+            for (int j = 0; j < p; ++j)
+                if (labelled(j, y) == UNK)
+                    labelled(j, y) = z_exists ? COM : REV;
         }
     }
 
     return labelled;
 }
 
-auto dag_to_cpdag(const torch::Tensor& G) {
+auto dag_to_cpdag(const Graph& G) {
     auto ordered = order_edges(G);
     auto labelled = label_edges(ordered);
-    auto cpdag = torch::zeros_like(labelled);
-    cpdag.index_put_({labelled == 1}, labelled.index({labelled == 1}));
-    int l1 = (int)labelled.size(0), l2 = (int)labelled.size(1);
-    for (int x = 0; x < l1; ++x) {
-        for (int y = 0; y < l2; ++y) {
-            if (labelled[x][y].item().toInt() == -1) {
-                cpdag[x][y] = 1;
-                cpdag[y][x] = 1;
+    int p = (int)labelled.rows();
+    Graph cpdag(p, p);
+    for (int x = 0; x < p; ++x) {
+        for (int y = 0; y < p; ++y) {
+            if (labelled(x, y) == 1) cpdag(x, y) = 1;
+            if (labelled(x, y) == -1) {
+                cpdag(x, y) = 1;
+                cpdag(y, x) = 1;
             }
         }
     }
     return cpdag;
 }
 
-auto pdag_to_cpdag(const torch::Tensor& pdag) {
+// Covariance of the lag-augmented variables [x_t, x_{t-1}, ..., x_{t-L}] over
+// t = L..T-1 of a [time x var] matrix. Accumulated in one pass over blocks of
+// rows, so the lagged design matrix is never materialized.
+auto lagged_covariance(const la::View<double>& X,
+                       int max_lag,
+                       int64_t block_rows = 4096) {
+    auto T = X.rows(), p = X.cols();
+    auto N = T - max_lag;
+    if (N < 2) throw "Not enough time steps for max_lag";
+    auto q = p * (max_lag + 1);
+    // Covariances are shift invariant; shifting by a rough mean keeps the
+    // accumulated sums well conditioned
+    auto shift = la::column_means({X.data(), std::min(T, block_rows), p});
+    la::Matrix<double> G(q, q);
+    std::vector<double> s(q, 0.0), Z;
+    for (int64_t t0 = max_lag; t0 < T; t0 += block_rows) {
+        auto b = std::min(block_rows, T - t0);
+        Z.resize(b * q);
+        for (int64_t r = 0; r < b; ++r)
+            for (int l = 0; l <= max_lag; ++l) {
+                auto row = X.row(t0 + r - l);
+                auto z = Z.data() + r * q + l * p;
+                for (int64_t i = 0; i < p; ++i) {
+                    z[i] = row[i] - shift[i];
+                    s[l * p + i] += z[i];
+                }
+            }
+        la::add_gram(Z.data(), b, q, G);
+    }
+    for (auto& v : s)
+        v /= double(N);
+    for (int64_t i = 0; i < q; ++i)
+        for (int64_t j = 0; j < q; ++j)
+            G(i, j) = (G(i, j) - double(N) * s[i] * s[j]) / double(N);
+    return G;
+}
+
+// Tiers of the lag-augmented variables, lag max_lag first and lag 0 last,
+// so that no edge points from a later time step into an earlier one
+auto lagged_tiers(int64_t p, int max_lag) {
+    std::vector<std::vector<int>> tiers;
+    for (int l = max_lag; l >= 0; --l) {
+        std::vector<int> tier;
+        for (int64_t i = 0; i < p; ++i)
+            tier.emplace_back(int(l * p + i));
+        tiers.emplace_back(std::move(tier));
+    }
+    return tiers;
+}
+
+auto pdag_to_cpdag(const Graph& pdag) {
     auto dag = pdag_to_dag(pdag);
     return dag_to_cpdag(dag);
 }